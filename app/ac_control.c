@@ -0,0 +1,167 @@
+#include "ac_control.h"
+#include "state_store.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+static MideaIR ir;
+static uint32_t generation = 0;
+static xSemaphoreHandle lock = NULL;
+
+void ac_control_init(uint8_t gpio)
+{
+    midea_ir_init(&ir, gpio);
+    state_store_init(&ir);
+
+    lock = xSemaphoreCreateMutex();
+}
+
+bool ac_control_execute(AcCommand cmd, int value)
+{
+    bool result = true;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    switch (cmd) {
+        case AC_CMD_ON:
+            ir.enabled = true;
+            break;
+        case AC_CMD_OFF:
+            ir.enabled = false;
+            break;
+        case AC_CMD_MODE:
+            if (ac_control_mode_name(value)) {
+                ir.mode = value;
+            } else {
+                result = false;
+            }
+            break;
+        case AC_CMD_TEMP:
+            if (value >= AC_TEMP_MIN && value <= AC_TEMP_MAX) {
+                ir.temperature = value;
+            } else {
+                result = false;
+            }
+            break;
+        case AC_CMD_FAN_LEVEL:
+            if (value >= 0 && value <= AC_FAN_LEVEL_MAX) {
+                ir.fan_level = value;
+            } else {
+                result = false;
+            }
+            break;
+        case AC_CMD_MOVE:
+            midea_ir_move_deflector(&ir);
+            xSemaphoreGive(lock);
+            return true;
+        default:
+            result = false;
+    }
+
+    if (result) {
+        printf("Sending ir code\n");
+        midea_ir_send(&ir);
+        state_store_update(&ir);
+        generation++;
+    }
+    xSemaphoreGive(lock);
+
+    return result;
+}
+
+bool ac_control_set(const MideaIR *state)
+{
+    if (!ac_control_state_valid(state)) {
+        return false;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    ir.enabled = state->enabled;
+    ir.mode = state->mode;
+    ir.temperature = state->temperature;
+    ir.fan_level = state->fan_level;
+
+    printf("Sending ir code\n");
+    midea_ir_send(&ir);
+    state_store_update(&ir);
+    generation++;
+    xSemaphoreGive(lock);
+
+    return true;
+}
+
+bool ac_control_command(const char *cmd)
+{
+    if (!strcmp(cmd, "on")) {
+        return ac_control_execute(AC_CMD_ON, 0);
+    } else if (!strcmp(cmd, "off")) {
+        return ac_control_execute(AC_CMD_OFF, 0);
+    } else if (!strcmp(cmd, "auto")) {
+        return ac_control_execute(AC_CMD_MODE, MODE_AUTO);
+    } else if (!strcmp(cmd, "cool")) {
+        return ac_control_execute(AC_CMD_MODE, MODE_COOL);
+    } else if (!strcmp(cmd, "heat")) {
+        return ac_control_execute(AC_CMD_MODE, MODE_HEAT);
+    } else if (!strncmp(cmd, "temp", 4)) {
+        return ac_control_execute(AC_CMD_TEMP, atoi(&cmd[5]));
+    } else if (!strcmp(cmd, "fan")) {
+        return ac_control_execute(AC_CMD_MODE, MODE_FAN);
+    } else if (!strncmp(cmd, "fan_level", 9)) {
+        return ac_control_execute(AC_CMD_FAN_LEVEL, atoi(&cmd[10]));
+    } else if (!strcmp(cmd, "move")) {
+        return ac_control_execute(AC_CMD_MOVE, 0);
+    }
+    printf("Unknown  command: %s\n", cmd);
+    return false;
+}
+
+uint32_t ac_control_get(MideaIR *state)
+{
+    uint32_t result;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    *state = ir;
+    result = generation;
+    xSemaphoreGive(lock);
+
+    return result;
+}
+
+uint32_t ac_control_format_status(char *buff)
+{
+    MideaIR state;
+    uint32_t result = ac_control_get(&state);
+    const char *mode = ac_control_mode_name(state.mode);
+
+    snprintf(buff, AC_STATUS_BUFF_SIZE, "%s %s %d %d",
+            state.enabled ? "on" : "off",
+            mode ? mode : "",
+            state.temperature, state.fan_level);
+
+    return result;
+}
+
+bool ac_control_state_valid(const MideaIR *state)
+{
+    return ac_control_mode_name(state->mode) &&
+        state->temperature >= AC_TEMP_MIN &&
+        state->temperature <= AC_TEMP_MAX &&
+        state->fan_level <= AC_FAN_LEVEL_MAX;
+}
+
+const char *ac_control_mode_name(int mode)
+{
+    switch (mode) {
+        case MODE_AUTO:
+            return "auto";
+        case MODE_COOL:
+            return "cool";
+        case MODE_HEAT:
+            return "heat";
+        case MODE_FAN:
+            return "fan";
+    }
+    return NULL;
+}
@@ -0,0 +1,81 @@
+/**
+ * The file implements control of the air conditioner state.
+ *
+ * All control paths (MQTT, local UDP, HTTP) change the state through this
+ * module, so the state is shared, the IR code is sent and the state is
+ * persisted the same way regardless of where the command came from.
+ */
+#ifndef __AC_CONTROL_H__
+#define __AC_CONTROL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "midea-ir.h"
+
+#define AC_STATUS_BUFF_SIZE 32
+
+#define AC_TEMP_MIN         17
+#define AC_TEMP_MAX         30
+#define AC_FAN_LEVEL_MAX    3
+
+typedef enum {
+    AC_CMD_ON = 0,
+    AC_CMD_OFF,
+    AC_CMD_MODE,        // value is one of MODE_AUTO, MODE_COOL, etc.
+    AC_CMD_TEMP,        // value is temperature AC_TEMP_MIN-AC_TEMP_MAX
+    AC_CMD_FAN_LEVEL,   // value is fan level 0-AC_FAN_LEVEL_MAX
+    AC_CMD_MOVE,        // move the deflector one position
+
+    AC_CMD_SIZE
+} AcCommand;
+
+/**
+ * Initialize IR sender on the given GPIO and restore the saved state.
+ */
+void ac_control_init(uint8_t gpio);
+
+/**
+ * Apply the command to the state and send the IR code.
+ * Return false if the command is unknown or the value is out of range.
+ */
+bool ac_control_execute(AcCommand cmd, int value);
+
+/**
+ * Set enabled, mode, temperature and fan level from 'state' at once and send
+ * a single IR code.
+ * Return false if any of the values is out of range.
+ */
+bool ac_control_set(const MideaIR *state);
+
+/**
+ * Parse and execute a text command, e.g. "on", "temp 24".
+ * See README.md for the list of commands.
+ * Return false if the command is unknown or the value is out of range.
+ */
+bool ac_control_command(const char *cmd);
+
+/**
+ * Copy the current state to 'state'.
+ * Return the state generation, it is incremented on each state change.
+ */
+uint32_t ac_control_get(MideaIR *state);
+
+/**
+ * Format the current state as a status message "SSS mode TT F".
+ * The buffer must be at least AC_STATUS_BUFF_SIZE bytes.
+ * Return the state generation.
+ */
+uint32_t ac_control_format_status(char *buff);
+
+/**
+ * Return true if the state values are in range. The same check is used
+ * when the state is restored from flash.
+ */
+bool ac_control_state_valid(const MideaIR *state);
+
+/**
+ * Return the mode name or NULL if the mode is unknown.
+ */
+const char *ac_control_mode_name(int mode);
+
+#endif // __AC_CONTROL_H__
@@ -7,11 +7,15 @@
 #include "esp8266.h"
 
 #include "app_config.h"
+#include "ac_control.h"
+#include "udp_ctrl.h"
+#include "wifi_conn.h"
+#include "metrics.h"
 
 #include "ota-tftp.h"
+#include "ota_packed.h"
 #include "rboot-api.h"
 
-#include "midea-ir.h"
 #include "httpd.h"
 
 #include <paho_mqtt_c/MQTTESP8266.h>
@@ -19,38 +23,14 @@
 
 #include "esp/gpio.h"
 
-static MideaIR ir;
 static MQTTClient mqtt_client = DefaultClient;
+static uint32_t published_generation = 0;
 
-#define STATUS_BUFF_SIZE 32
 static inline void publish_status()
 {
-    char buff[STATUS_BUFF_SIZE];
+    char buff[AC_STATUS_BUFF_SIZE];
 
-    memset(buff, 0, STATUS_BUFF_SIZE);
-
-    if (ir.enabled) {
-        strcat(buff, "on ");
-    } else {
-        strcat(buff, "off ");
-    }
-
-    switch (ir.mode) {
-        case MODE_AUTO:
-            strcat(buff, "auto ");
-            break;
-        case MODE_COOL:
-            strcat(buff, "cool ");
-            break;
-        case MODE_HEAT:
-            strcat(buff, "heat ");
-            break;
-        case MODE_FAN:
-            strcat(buff, "fan ");
-            break;
-    }
-    
-    sprintf(buff + strlen(buff), "%d %d", ir.temperature, ir.fan_level);
+    published_generation = ac_control_format_status(buff);
    
     printf("status: %s\n", buff); 
 
@@ -68,33 +48,40 @@ static inline void publish_status()
     }
 }
 
-static inline void process_command(const char *cmd)
+/**
+ * The broker publishes the last will when nothing is heard from the device
+ * for 1.5 keep-alive intervals. 30 seconds keeps the ping traffic of a large
+ * fleet low and still reports a dead device within 45 seconds.
+ */
+#define MQTT_KEEP_ALIVE 30
+
+/**
+ * Presence payloads are sent without the terminating zero, the same way the
+ * broker sends the will.
+ */
+#define PRESENCE_OFFLINE "offline"
+
+#define PRESENCE_BUFF_SIZE 32
+static inline void publish_birth()
 {
-    if (!strcmp(cmd, "on")) {
-        ir.enabled = true; 
-    } else if (!strcmp(cmd, "off")) {
-        ir.enabled = false;
-    } else if (!strcmp(cmd, "auto")) {
-        ir.mode = MODE_AUTO;
-    } else if (!strcmp(cmd, "cool")) {
-        ir.mode = MODE_COOL;
-    } else if (!strcmp(cmd, "heat")) {
-        ir.mode = MODE_HEAT;
-    } else if (!strncmp(cmd, "temp", 4)) {
-        ir.temperature = atoi(&cmd[5]);
-    } else if (!strcmp(cmd, "fan")) {
-        ir.mode = MODE_FAN;
-    } else if (!strncmp(cmd, "fan_level", 9)) {
-        ir.fan_level = atoi(&cmd[10]);
-    } else if (!strcmp(cmd, "move")) {
-        midea_ir_move_deflector(&ir);
-        return;
-    } else {
-        printf("Unknown  command: %s\n", cmd);
-        return;
+    char buff[PRESENCE_BUFF_SIZE];
+    rboot_config conf = rboot_get_config();
+
+    snprintf(buff, PRESENCE_BUFF_SIZE, "online %d %s %d", conf.current_rom,
+            FIRMWARE_VERSION, metrics_get_mqtt_ready_ms());
+
+    printf("presence: %s\n", buff);
+
+    MQTTMessage message;
+    message.payload = buff;
+    message.payloadlen = strlen(buff);
+    message.dup = 0;
+    message.qos = QOS1;
+    message.retained = 1;
+    if (MQTTPublish(&mqtt_client, config_get_presence_topic(), &message)
+            != SUCCESS ) {
+        printf("error while publishing presence\n");
     }
-    printf("Sending ir code\n");
-    midea_ir_send(&ir); 
 }
 
 #define CMD_BUFF_SIZE 32
@@ -117,36 +104,56 @@ static void  topic_received(MessageData *md)
     memset(cmd, 0, CMD_BUFF_SIZE);
     memcpy(cmd, message->payload, message->payloadlen);
 
-    process_command(cmd);
+    ac_control_command(cmd);
     publish_status();
 }
 
 
+/**
+ * Each device needs its own client id, otherwise the broker drops the
+ * session of one device when another one connects.
+ * MQTT 3.1 limits client id to 23 characters.
+ */
+#define CLIENT_ID_SIZE 24
+static inline void fill_client_id(char *client_id)
+{
+    uint8_t mac[6];
+
+    sdk_wifi_get_macaddr(STATION_IF, mac);
+    snprintf(client_id, CLIENT_ID_SIZE, "gizmo-ir-%02x%02x%02x%02x%02x%02x",
+            mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
 static inline void mqtt_task()
 {
     struct Network network;
-    char client_id[20];
+    char client_id[CLIENT_ID_SIZE];
     uint8_t mqtt_buf[100];
     uint8_t mqtt_readbuf[100];
     MQTTPacket_connectData data = MQTTPacket_connectData_initializer;
 
     NewNetwork( &network );
-    strcpy(client_id, "esp-gizmo-ir");
+    fill_client_id(client_id);
 
     if (ConnectNetwork(&network, config_get_mqtt_host(),
                 config_get_mqtt_port()) != 0) {
         printf("Connect to MQTT server failed\n");
+        wifi_conn_invalidate();
         return;
     }
 
     NewMQTTClient(&mqtt_client, &network, 5000, mqtt_buf, 100, mqtt_readbuf, 100);
 
-    data.willFlag       = 0;
+    data.willFlag       = 1;
+    data.will.topicName.cstring = (char*)config_get_presence_topic();
+    data.will.message.cstring   = PRESENCE_OFFLINE;
+    data.will.retained  = 1;
+    data.will.qos       = QOS1;
     data.MQTTVersion    = 3;
     data.clientID.cstring   = client_id;
     data.username.cstring   = NULL;
     data.password.cstring   = NULL;
-    data.keepAliveInterval  = 10;
+    data.keepAliveInterval  = MQTT_KEEP_ALIVE;
     data.cleansession   = 0;
 
     printf("Send MQTT connect ... \n");
@@ -162,7 +169,17 @@ static inline void mqtt_task()
         return;
     }
 
+    metrics_mark_mqtt_ready();
+    publish_birth();
+    publish_status();
+
     while (MQTTYield(&mqtt_client, 1000) != DISCONNECTED) {
+        MideaIR state;
+        if (ac_control_get(&state) != published_generation) {
+            // state was changed by a local control path
+            publish_status();
+        }
+        wifi_conn_check();
         printf("free heap: %d bytes\n", xPortGetFreeHeapSize());
         uint16_t free_stack = uxTaskGetStackHighWaterMark(xTaskGetCurrentTaskHandle());
         printf("minimum free stack: %d bytes\n", free_stack);
@@ -173,21 +190,11 @@ static inline void mqtt_task()
 
 static void main_task(void *pvParams)
 {
-    struct sdk_station_config config;
-    strcpy((char*)config.ssid, config_get_ssid());
-    strcpy((char*)config.password, config_get_ssid_pass());
-
-    sdk_wifi_set_opmode(STATION_MODE);
-    sdk_wifi_station_set_config(&config);
+    wifi_conn_start();
 
     while (true) {
-        uint8_t status = sdk_wifi_station_get_connect_status();
-        if (status == STATION_GOT_IP) {
-            mqtt_task();
-        } else {
-            printf("Not connected\n");
-            vTaskDelay(1000/portTICK_RATE_MS);
-        }
+        wifi_conn_wait();
+        mqtt_task();
     }
 }
 
@@ -206,7 +213,7 @@ void user_init(void)
 {
     uart_set_baud(0, 115200);
 
-    midea_ir_init(&ir, 14);
+    ac_control_init(14);
     config_init();
 
     rboot_config conf = rboot_get_config();
@@ -220,8 +227,12 @@ void user_init(void)
     }
     start_config_server();
 
-    xTaskCreate(main_task, (signed char *)"main", 512, NULL, 4, NULL);
+    xTaskHandle task = NULL;
+    xTaskCreate(main_task, (signed char *)"main", 512, NULL, 4, &task);
+    metrics_add_task("main", task);
     /* xTaskCreate(test_task, (signed char *)"test", 512, NULL, 2, NULL); */
 
     ota_tftp_init_server(TFTP_PORT);
+    ota_packed_init_server(OTA_PACKED_PORT);
+    udp_ctrl_init();
 }
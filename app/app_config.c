@@ -9,6 +9,8 @@
 #include <stdio.h>
 
 #include "httpd.h"
+#include "http_api.h"
+#include "metrics.h"
 
 static const char *name = "name_0";
 static const char *location = "room_0";
@@ -19,6 +21,7 @@ static const int mqtt_port = 1883;
 
 static char *cmd_topic;
 static char *status_topic;
+static char *presence_topic;
 
 
 typedef enum {
@@ -82,18 +85,18 @@ static void http_req_handler(Httpd *httpd, const char *url, MethodType method)
             if (!strcmp(url, "/")) {
                 httpd_send_header(httpd, true);
                 httpd_send_data(httpd, index_html, strlen(index_html));
-            } else {
+            } else if (!http_api_get(httpd, url)) {
                 httpd_send_header(httpd, false);
             }
             break;
         case HTTP_POST:
             printf("Http post request for url %s received\n", url);
+            httpd->user_data = 0;
             if (!strcmp(url, "/config")) {
                 httpd_send_header(httpd, true);
-            } else {
+            } else if (!http_api_post(httpd, url)) {
                 httpd_send_header(httpd, false);
             }
-            httpd->user_data = 0;
             break;
         default:
             printf("Unknown method\n");
@@ -103,11 +106,17 @@ static void http_req_handler(Httpd *httpd, const char *url, MethodType method)
 static void http_data_handler(Httpd *httpd, const char *name, 
         const void *data, uint16_t len)
 {
+    if (http_api_data(httpd, name, data, len)) {
+        return;
+    }
     printf("data name=%s, len=%d\n", name, len);
 }
 
 static void http_data_complete_handler(Httpd *httpd, bool result)
 {
+    if (http_api_complete(httpd, result)) {
+        return;
+    }
     printf("data transfer complete\n"); 
     if (result) {
         char page[] = "<html><body>\
@@ -130,11 +139,14 @@ static void httpd_task(void *pvParams)
     httpd_init(&httpd);
 
     httpd_serve(&httpd, 80);
+    vTaskDelete(NULL);
 }
 
 void start_config_server()
 {
-    xTaskCreate(httpd_task, (signed char *)"httpd", 512, NULL, 2, NULL);
+    xTaskHandle task = NULL;
+    xTaskCreate(httpd_task, (signed char *)"httpd", 640, NULL, 2, &task);
+    metrics_add_task("httpd", task);
 }
 
 static inline void fill_topic_base(char *str_buff)
@@ -155,6 +167,7 @@ void config_init()
 
     cmd_topic = (char*)malloc(base_size + sizeof("cmd"));
     status_topic = (char*)malloc(base_size + sizeof("status"));
+    presence_topic = (char*)malloc(base_size + sizeof("presence"));
 
     fill_topic_base(cmd_topic);
     strcat(cmd_topic, "cmd");
@@ -162,6 +175,8 @@ void config_init()
     fill_topic_base(status_topic);
     strcat(status_topic, "status");
 
+    fill_topic_base(presence_topic);
+    strcat(presence_topic, "presence");
 }
 
 const char* config_get_name()
@@ -203,3 +218,8 @@ const char* config_get_cmd_topic()
 {
     return cmd_topic;
 }
+
+const char* config_get_presence_topic()
+{
+    return presence_topic;
+}
@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 #define CONFIG_DEVICE_TYPE "esp-gizmo-ir"
+#define FIRMWARE_VERSION "0.2"
 
 void config_init();
 
@@ -22,5 +23,6 @@ const int config_get_mqtt_port();
 
 const char* config_get_status_topic();
 const char* config_get_cmd_topic();
+const char* config_get_presence_topic();
 
 #endif // __APP_CONFIG_H__
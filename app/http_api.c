@@ -0,0 +1,167 @@
+#include "http_api.h"
+#include "ac_control.h"
+#include "metrics.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define API_POST_STATE  ((void*)1)
+
+#define JSON_BUFF_SIZE  256
+#define FIELD_BUFF_SIZE 8
+#define CONTENT_TYPE    "application/json"
+
+/**
+ * The server handles one request at a time, so a single pending state is
+ * enough.
+ */
+static MideaIR pending;
+static bool pending_valid;
+
+static void send_state(Httpd *httpd)
+{
+    char buff[JSON_BUFF_SIZE];
+    MideaIR state;
+    const char *mode;
+
+    ac_control_get(&state);
+    mode = ac_control_mode_name(state.mode);
+
+    snprintf(buff, JSON_BUFF_SIZE, "{\"enabled\":%s,\"mode\":\"%s\","
+            "\"temperature\":%d,\"fan_level\":%d}",
+            state.enabled ? "true" : "false", mode ? mode : "",
+            state.temperature, state.fan_level);
+    httpd_send_data(httpd, buff, strlen(buff));
+}
+
+static void send_metrics(Httpd *httpd)
+{
+    char buff[JSON_BUFF_SIZE];
+
+    int len = metrics_format_json(buff, JSON_BUFF_SIZE);
+    httpd_send_data(httpd, buff, len);
+}
+
+static int parse_mode(const char *value)
+{
+    static const int modes[] = {MODE_AUTO, MODE_COOL, MODE_HEAT, MODE_FAN};
+
+    for (uint8_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (!strcmp(value, ac_control_mode_name(modes[i]))) {
+            return modes[i];
+        }
+    }
+    return -1;
+}
+
+bool http_api_get(Httpd *httpd, const char *url)
+{
+    if (!strcmp(url, "/api/state")) {
+        httpd_send_status(httpd, 200, CONTENT_TYPE);
+        send_state(httpd);
+    } else if (!strcmp(url, "/api/metrics")) {
+        httpd_send_status(httpd, 200, CONTENT_TYPE);
+        send_metrics(httpd);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Parse decimal number in range min-max.
+ * Return -1 if the value is not a number or is out of range.
+ */
+static int parse_number(const char *value, int min, int max)
+{
+    char *end;
+    long number = strtol(value, &end, 10);
+
+    if (!*value || *end || number < min || number > max) {
+        return -1;
+    }
+    return number;
+}
+
+bool http_api_post(Httpd *httpd, const char *url)
+{
+    if (strcmp(url, "/api/state")) {
+        return false;
+    }
+
+    ac_control_get(&pending);
+    pending_valid = true;
+    httpd->user_data = API_POST_STATE;
+    // the status is known only when the whole form is received
+    return true;
+}
+
+bool http_api_data(Httpd *httpd, const char *name, const void *data,
+        uint16_t len)
+{
+    char value[FIELD_BUFF_SIZE];
+
+    if (httpd->user_data != API_POST_STATE) {
+        return false;
+    }
+
+    if (len >= FIELD_BUFF_SIZE) {
+        pending_valid = false;
+        return true;
+    }
+    memcpy(value, data, len);
+    value[len] = 0;
+
+    if (!strcmp(name, "enabled")) {
+        if (!strcmp(value, "on") || !strcmp(value, "1")) {
+            pending.enabled = true;
+        } else if (!strcmp(value, "off") || !strcmp(value, "0")) {
+            pending.enabled = false;
+        } else {
+            pending_valid = false;
+        }
+    } else if (!strcmp(name, "mode")) {
+        int mode = parse_mode(value);
+        if (mode >= 0) {
+            pending.mode = mode;
+        } else {
+            pending_valid = false;
+        }
+    } else if (!strcmp(name, "temperature")) {
+        int temperature = parse_number(value, AC_TEMP_MIN, AC_TEMP_MAX);
+        if (temperature >= 0) {
+            pending.temperature = temperature;
+        } else {
+            pending_valid = false;
+        }
+    } else if (!strcmp(name, "fan_level")) {
+        int fan_level = parse_number(value, 0, AC_FAN_LEVEL_MAX);
+        if (fan_level >= 0) {
+            pending.fan_level = fan_level;
+        } else {
+            pending_valid = false;
+        }
+    } else {
+        pending_valid = false;
+    }
+    return true;
+}
+
+bool http_api_complete(Httpd *httpd, bool result)
+{
+    if (httpd->user_data != API_POST_STATE) {
+        return false;
+    }
+    httpd->user_data = 0;
+
+    if (result && pending_valid && ac_control_set(&pending)) {
+        httpd_send_status(httpd, 200, CONTENT_TYPE);
+        send_state(httpd);
+    } else {
+        char reply[] = "{\"error\":\"invalid state\"}";
+        httpd_send_status(httpd, 400, CONTENT_TYPE);
+        httpd_send_data(httpd, reply, strlen(reply));
+    }
+    return true;
+}
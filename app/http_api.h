@@ -0,0 +1,45 @@
+/**
+ * The file implements local REST API on top of the config http server.
+ *
+ *  GET  /api/state   - current state as JSON object:
+ *                      {"enabled":true,"mode":"cool","temperature":24,
+ *                       "fan_level":2}
+ *  POST /api/state   - set state, form fields "enabled" (on/off or 1/0),
+ *                      "mode", "temperature", "fan_level". Missing fields
+ *                      keep their current values. Replies with the new state,
+ *                      or with 400 and {"error":"invalid state"} if a field
+ *                      is unknown or out of range.
+ *  GET  /api/metrics - free heap, stack high-water marks and boot timings.
+ *
+ * All replies are application/json.
+ */
+#ifndef __HTTP_API_H__
+#define __HTTP_API_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "httpd.h"
+
+/**
+ * Handle GET request. Return false if the url is not an API url.
+ */
+bool http_api_get(Httpd *httpd, const char *url);
+
+/**
+ * Handle POST request. Return false if the url is not an API url.
+ */
+bool http_api_post(Httpd *httpd, const char *url);
+
+/**
+ * Handle form field of a POST request.
+ * Return false if the request is not an API request.
+ */
+bool http_api_data(Httpd *httpd, const char *name, const void *data,
+        uint16_t len);
+
+/**
+ * Finish POST request. Return false if the request is not an API request.
+ */
+bool http_api_complete(Httpd *httpd, bool result);
+
+#endif // __HTTP_API_H__
@@ -0,0 +1,75 @@
+#include "metrics.h"
+#include "state_store.h"
+#include "espressif/esp_common.h"
+
+#include <stdio.h>
+
+static uint32_t wifi_ready_ms = 0;
+static uint32_t mqtt_ready_ms = 0;
+
+static struct {
+    const char *name;
+    xTaskHandle handle;
+} tasks[METRICS_MAX_TASKS];
+static uint8_t task_count = 0;
+
+static inline uint32_t time_since_boot_ms()
+{
+    return sdk_system_get_time() / 1000;
+}
+
+void metrics_mark_wifi_ready()
+{
+    if (!wifi_ready_ms) {
+        wifi_ready_ms = time_since_boot_ms();
+        printf("boot to WiFi ready: %d ms\n", wifi_ready_ms);
+    }
+}
+
+void metrics_mark_mqtt_ready()
+{
+    if (!mqtt_ready_ms) {
+        mqtt_ready_ms = time_since_boot_ms();
+        printf("boot to MQTT ready: %d ms\n", mqtt_ready_ms);
+    }
+}
+
+uint32_t metrics_get_wifi_ready_ms()
+{
+    return wifi_ready_ms;
+}
+
+uint32_t metrics_get_mqtt_ready_ms()
+{
+    return mqtt_ready_ms;
+}
+
+void metrics_add_task(const char *name, xTaskHandle task)
+{
+    if (task_count < METRICS_MAX_TASKS && task) {
+        tasks[task_count].name = name;
+        tasks[task_count].handle = task;
+        task_count++;
+    }
+}
+
+int metrics_format_json(char *buff, int size)
+{
+    int len = snprintf(buff, size, "{\"uptime_ms\":%u,\"free_heap\":%u,"
+            "\"wifi_ready_ms\":%u,\"mqtt_ready_ms\":%u,"
+            "\"state_writes\":%u,\"free_stack\":{",
+            (unsigned)time_since_boot_ms(), (unsigned)xPortGetFreeHeapSize(),
+            (unsigned)wifi_ready_ms, (unsigned)mqtt_ready_ms,
+            (unsigned)state_store_get_write_count());
+
+    for (uint8_t i = 0; i < task_count && len < size; i++) {
+        // high-water mark is in words
+        len += snprintf(buff + len, size - len, "%s\"%s\":%u",
+                i ? "," : "", tasks[i].name,
+                (unsigned)uxTaskGetStackHighWaterMark(tasks[i].handle) * 4);
+    }
+    if (len < size) {
+        len += snprintf(buff + len, size - len, "}}");
+    }
+    return len < size ? len : size - 1;
+}
@@ -0,0 +1,47 @@
+/**
+ * The file implements runtime metrics of the device.
+ */
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define METRICS_MAX_TASKS 6
+
+/**
+ * Record the time since boot when WiFi connection got an IP address.
+ * Only the first call after boot is recorded.
+ */
+void metrics_mark_wifi_ready();
+
+/**
+ * Record the time since boot when MQTT client became ready to receive
+ * commands. Only the first call after boot is recorded.
+ */
+void metrics_mark_mqtt_ready();
+
+/**
+ * Return boot to WiFi ready time in milliseconds, 0 if not ready yet.
+ */
+uint32_t metrics_get_wifi_ready_ms();
+
+/**
+ * Return boot to MQTT ready time in milliseconds, 0 if not ready yet.
+ */
+uint32_t metrics_get_mqtt_ready_ms();
+
+/**
+ * Register a task to report its stack high-water mark.
+ * 'name' must be a static string.
+ */
+void metrics_add_task(const char *name, xTaskHandle task);
+
+/**
+ * Format all metrics as a JSON object into 'buff' of 'size' bytes.
+ * Return the length of the resulting string.
+ */
+int metrics_format_json(char *buff, int size);
+
+#endif // __METRICS_H__
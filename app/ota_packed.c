@@ -0,0 +1,455 @@
+#include "ota_packed.h"
+#include "esp_config.h"
+#include "metrics.h"
+#include "espressif/esp_common.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <espressif/spi_flash.h>
+#include <lwip/sockets.h>
+
+#include "rboot-api.h"
+
+#define HEADER_SIZE         24
+#define PAGE_SIZE           256
+#define BASE_CACHE_SIZE     64
+#define RECV_BUFF_SIZE      512
+#define RECV_TIMEOUT_MS     10000
+
+// SDK system parameters at the end of the flash
+#define SDK_PARAM_SIZE      (4 * SPI_FLASH_SEC_SIZE)
+
+#define TAG_MATCH           0x80
+#define TAG_BASE_COPY       0xC0
+#define MIN_MATCH           3
+
+typedef enum {
+    ST_HEADER = 0,
+    ST_TAG,
+    ST_LITERAL,
+    ST_DISTANCE,
+    ST_BASE_OFFSET,
+    ST_BASE_LENGTH,
+    ST_DONE,
+    ST_ERROR,
+} UnpackState;
+
+typedef struct {
+    UnpackState state;
+    const char *error;
+
+    uint8_t header[HEADER_SIZE];
+    uint8_t header_len;
+
+    uint8_t flags;
+    uint32_t window_size;
+    uint32_t image_len;
+    uint32_t image_crc;
+    uint32_t base_len;
+    uint32_t base_crc;
+
+    uint32_t dest_addr;
+    uint32_t dest_size;
+    uint32_t base_addr;
+    uint32_t base_size;
+
+    uint32_t out_pos;
+    uint32_t crc;
+
+    uint32_t count;     // bytes left in the current literal or match
+    uint32_t value;     // distance or varint being parsed
+    uint8_t shift;
+    int32_t base_delta;
+
+    // buffers are 4 bytes alligned for flash operations
+    uint32_t page[PAGE_SIZE / 4];
+    uint16_t page_len;
+    uint32_t base_cache[BASE_CACHE_SIZE / 4];
+    uint32_t base_cache_offset;
+    uint8_t window[1 << OTA_MAX_WINDOW_BITS];
+} Unpack;
+
+/**
+ * CRC32 as in zlib, bitwise to save RAM for the table.
+ */
+static inline uint32_t crc32_update(uint32_t crc, uint8_t byte)
+{
+    crc ^= byte;
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return crc;
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void set_error(Unpack *u, const char *error)
+{
+    u->state = ST_ERROR;
+    u->error = error;
+}
+
+static void flush_page(Unpack *u)
+{
+    uint32_t addr = u->dest_addr + ((u->out_pos - 1) & ~(PAGE_SIZE - 1));
+
+    if (addr % SPI_FLASH_SEC_SIZE == 0) {
+        sdk_spi_flash_erase_sector(addr / SPI_FLASH_SEC_SIZE);
+    }
+
+    // pad with 0xFF up to 4 bytes, the same as erased flash
+    while (u->page_len % 4) {
+        ((uint8_t*)u->page)[u->page_len++] = 0xFF;
+    }
+    if (sdk_spi_flash_write(addr, u->page, u->page_len)
+            != SPI_FLASH_RESULT_OK) {
+        set_error(u, "flash write error");
+    }
+    u->page_len = 0;
+}
+
+static void put_byte(Unpack *u, uint8_t byte)
+{
+    if (u->out_pos >= u->image_len) {
+        set_error(u, "image is longer than specified");
+        return;
+    }
+
+    u->window[u->out_pos & (u->window_size - 1)] = byte;
+    ((uint8_t*)u->page)[u->page_len++] = byte;
+    u->crc = crc32_update(u->crc, byte);
+    u->out_pos++;
+
+    if (u->page_len == PAGE_SIZE || u->out_pos == u->image_len) {
+        flush_page(u);
+    }
+}
+
+static bool read_base(Unpack *u, uint32_t offset, uint8_t *byte)
+{
+    uint32_t alligned = offset & ~(BASE_CACHE_SIZE - 1);
+
+    if (offset >= u->base_len) {
+        return false;
+    }
+    if (alligned != u->base_cache_offset) {
+        if (sdk_spi_flash_read(u->base_addr + alligned, u->base_cache,
+                    BASE_CACHE_SIZE) != SPI_FLASH_RESULT_OK) {
+            return false;
+        }
+        u->base_cache_offset = alligned;
+    }
+    *byte = ((uint8_t*)u->base_cache)[offset - alligned];
+    return true;
+}
+
+static void parse_header(Unpack *u)
+{
+    uint8_t *h = u->header;
+    uint8_t window_bits = h[5];
+
+    if (memcmp(h, OTA_PACKED_MAGIC, 4)) {
+        set_error(u, "bad magic");
+        return;
+    }
+    if (window_bits > OTA_MAX_WINDOW_BITS) {
+        set_error(u, "window is too big");
+        return;
+    }
+    u->flags = h[4];
+    u->window_size = 1 << window_bits;
+    u->image_len = read_u32(h + 8);
+    u->image_crc = read_u32(h + 12);
+    u->base_len = read_u32(h + 16);
+    u->base_crc = read_u32(h + 20);
+
+    if (!u->image_len || u->image_len > u->dest_size) {
+        set_error(u, "bad image size");
+    } else if (u->flags & OTA_FLAG_DELTA) {
+        uint32_t crc = 0xFFFFFFFF;
+        uint8_t byte;
+
+        if (u->base_len > u->base_size) {
+            set_error(u, "bad base size");
+            return;
+        }
+        for (uint32_t i = 0; i < u->base_len; i++) {
+            if (!read_base(u, i, &byte)) {
+                set_error(u, "base read error");
+                return;
+            }
+            crc = crc32_update(crc, byte);
+        }
+        if (~crc != u->base_crc) {
+            set_error(u, "base image mismatch");
+            return;
+        }
+    }
+    u->state = ST_TAG;
+}
+
+static void copy_match(Unpack *u)
+{
+    uint32_t distance = u->value + 1;
+
+    if (distance > u->window_size || distance > u->out_pos) {
+        set_error(u, "bad match distance");
+        return;
+    }
+    while (u->count-- && u->state != ST_ERROR) {
+        put_byte(u, u->window[(u->out_pos - distance) & (u->window_size - 1)]);
+    }
+}
+
+static void copy_base(Unpack *u)
+{
+    uint32_t offset = u->out_pos + u->base_delta;
+    uint8_t byte;
+
+    while (u->count-- && u->state != ST_ERROR) {
+        if (!read_base(u, offset++, &byte)) {
+            set_error(u, "bad base copy");
+            return;
+        }
+        put_byte(u, byte);
+    }
+}
+
+/**
+ * Accumulate varint byte in u->value.
+ * Return true when the varint is complete.
+ */
+static inline bool parse_varint(Unpack *u, uint8_t byte)
+{
+    if (u->shift > 28) {
+        set_error(u, "bad varint");
+        return false;
+    }
+    u->value |= (uint32_t)(byte & 0x7F) << u->shift;
+    u->shift += 7;
+    return !(byte & 0x80);
+}
+
+static void unpack_byte(Unpack *u, uint8_t byte)
+{
+    switch (u->state) {
+        case ST_HEADER:
+            u->header[u->header_len++] = byte;
+            if (u->header_len == HEADER_SIZE) {
+                parse_header(u);
+            }
+            return;
+        case ST_TAG:
+            u->value = 0;
+            u->shift = 0;
+            if (byte < TAG_MATCH) {
+                u->count = byte + 1;
+                u->state = ST_LITERAL;
+            } else if (byte < TAG_BASE_COPY) {
+                u->count = byte - TAG_MATCH + MIN_MATCH;
+                u->state = ST_DISTANCE;
+            } else if (byte == TAG_BASE_COPY && (u->flags & OTA_FLAG_DELTA)) {
+                u->state = ST_BASE_OFFSET;
+            } else {
+                set_error(u, "bad tag");
+            }
+            return;
+        case ST_LITERAL:
+            put_byte(u, byte);
+            if (--u->count == 0 && u->state != ST_ERROR) {
+                u->state = ST_TAG;
+            }
+            break;
+        case ST_DISTANCE:
+            u->value |= (uint32_t)byte << u->shift;
+            u->shift += 8;
+            if (u->shift == 16) {
+                u->state = ST_TAG;
+                copy_match(u);
+            }
+            break;
+        case ST_BASE_OFFSET:
+            if (parse_varint(u, byte)) {
+                // zigzag decoding
+                u->base_delta = (u->value >> 1) ^ -(int32_t)(u->value & 1);
+                u->value = 0;
+                u->shift = 0;
+                u->state = ST_BASE_LENGTH;
+            }
+            break;
+        case ST_BASE_LENGTH:
+            if (parse_varint(u, byte)) {
+                u->count = u->value;
+                u->state = ST_TAG;
+                copy_base(u);
+            }
+            break;
+        default:
+            return;
+    }
+
+    if (u->state == ST_TAG && u->out_pos == u->image_len) {
+        u->state = ST_DONE;
+    }
+}
+
+/**
+ * Return the size of the flash region starting at 'addr' up to the next
+ * rboot slot. Slots below the config area end at the config area, slots
+ * above the application data (CONFIG_APP_DATA_SIZE from the config base)
+ * end at the SDK parameters at the end of the flash.
+ */
+static uint32_t region_size(rboot_config *conf, uint32_t addr)
+{
+    uint32_t end = sdk_flashchip.chip_size - SDK_PARAM_SIZE;
+
+    if (addr < CONFIG_FLASH_BASE_ADDR + CONFIG_APP_DATA_SIZE) {
+        end = CONFIG_FLASH_BASE_ADDR;
+    }
+
+    for (uint8_t i = 0; i < conf->count; i++) {
+        if (conf->roms[i] > addr && conf->roms[i] < end) {
+            end = conf->roms[i];
+        }
+    }
+    return end > addr ? end - addr : 0;
+}
+
+static bool receive_image(int sock, uint8_t slot)
+{
+    rboot_config conf = rboot_get_config();
+    bool result = false;
+
+    Unpack *u = (Unpack*)malloc(sizeof(Unpack));
+    uint8_t *buff = (uint8_t*)malloc(RECV_BUFF_SIZE);
+    if (!u || !buff) {
+        printf("OTA: not enough memory\n");
+        free(u);
+        free(buff);
+        return false;
+    }
+
+    memset(u, 0, sizeof(Unpack));
+    u->crc = 0xFFFFFFFF;
+    u->base_cache_offset = 0xFFFFFFFF;
+    u->dest_addr = conf.roms[slot];
+    u->dest_size = region_size(&conf, u->dest_addr);
+    u->base_addr = conf.roms[conf.current_rom];
+    u->base_size = region_size(&conf, u->base_addr);
+
+    int received = 0;
+    while (u->state != ST_DONE && u->state != ST_ERROR) {
+        // a stalled sender must not block the OTA server forever
+        struct timeval tv = {
+            .tv_sec = RECV_TIMEOUT_MS / 1000,
+            .tv_usec = (RECV_TIMEOUT_MS % 1000) * 1000,
+        };
+        fd_set fds;
+        int len;
+
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        if (lwip_select(sock + 1, &fds, NULL, NULL, &tv) <= 0) {
+            set_error(u, "receive timeout");
+            break;
+        }
+        len = lwip_recv(sock, buff, RECV_BUFF_SIZE, 0);
+        if (len <= 0) {
+            set_error(u, "connection closed");
+            break;
+        }
+        received += len;
+        for (int i = 0; i < len && u->state != ST_ERROR; i++) {
+            unpack_byte(u, buff[i]);
+        }
+    }
+
+    if (u->state == ST_DONE && ~u->crc != u->image_crc) {
+        set_error(u, "image crc mismatch");
+    }
+
+    if (u->state == ST_DONE) {
+        uint32_t image_length;
+        const char *error;
+        if (rboot_verify_image(u->dest_addr, &image_length, &error)) {
+            printf("OTA: received %d bytes, unpacked %d bytes\n",
+                    received, u->image_len);
+            result = true;
+        } else {
+            set_error(u, error);
+        }
+    }
+
+    if (result) {
+        lwip_send(sock, "OK\n", 3, 0);
+    } else {
+        printf("OTA: %s\n", u->error);
+        snprintf((char*)buff, RECV_BUFF_SIZE, "ERR %s\n", u->error);
+        lwip_send(sock, buff, strlen((char*)buff), 0);
+    }
+
+    free(buff);
+    free(u);
+    return result;
+}
+
+static void ota_packed_task(void *pvParams)
+{
+    struct sockaddr_in addr;
+    uint16_t port = (uintptr_t)pvParams;
+
+    int sock = lwip_socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        printf("OTA socket error\n");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (lwip_bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+            lwip_listen(sock, 1) < 0) {
+        printf("OTA bind error\n");
+        lwip_close(sock);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (true) {
+        int conn = lwip_accept(sock, NULL, NULL);
+        if (conn < 0) {
+            continue;
+        }
+
+        rboot_config conf = rboot_get_config();
+        uint8_t slot = (conf.current_rom + 1) % conf.count;
+        printf("OTA: receiving packed image to slot %d\n", slot);
+
+        bool result = receive_image(conn, slot);
+        lwip_close(conn);
+
+        if (result) {
+            printf("OTA: switching to slot %d and restarting\n", slot);
+            rboot_set_current_rom(slot);
+            vTaskDelay(500 / portTICK_RATE_MS);
+            sdk_system_restart();
+        }
+    }
+}
+
+void ota_packed_init_server(uint16_t port)
+{
+    xTaskHandle task = NULL;
+    xTaskCreate(ota_packed_task, (signed char *)"ota", 384,
+            (void*)(uintptr_t)port, 2, &task);
+    metrics_add_task("ota", task);
+}
@@ -0,0 +1,52 @@
+/**
+ * The file implements OTA update with compressed and delta images.
+ *
+ * A packed image is received over TCP on OTA_PACKED_PORT and is unpacked on
+ * the fly straight into the spare rboot slot. Only a small fixed window of
+ * the output is kept in RAM. When the whole image is unpacked and its CRC
+ * matches the device switches to the new slot and restarts.
+ * Packed images are made by tools/ota_pack.py.
+ *
+ * Packed image structure, all fields are little endian:
+ *
+ *  4 bytes  1 byte  1 byte       2 bytes   4 bytes    4 bytes
+ * +--------+-------+------------+--------+-----------+-----------+
+ * | "GZP1" | flags | window bits| unused | image len | image crc |
+ * +--------+-------+------------+--------+-----------+-----------+
+ *  4 bytes    4 bytes
+ * +----------+----------+---------------------------------------+
+ * | base len | base crc |  ops ...                              |
+ * +----------+----------+---------------------------------------+
+ *
+ * If OTA_FLAG_DELTA is set in flags the image is a delta against the first
+ * 'base len' bytes of the currently running slot, which must have CRC32
+ * equal to 'base crc'. CRC32 is the same as in zlib.
+ *
+ * Ops, the first byte is a tag:
+ *  0x00-0x7F  literal: (tag + 1) bytes follow and are copied to output.
+ *  0x80-0xBF  match: u16 distance-1 follows. (tag - 0x80 + 3) bytes are
+ *             copied from 'distance' bytes back in output. The distance is
+ *             not greater than 2^window_bits.
+ *  0xC0       base copy: varint zigzag offset delta and varint length follow.
+ *             'length' bytes are copied from the base slot starting at
+ *             output position + offset delta. Only in delta images.
+ * Varints are 7 bits per byte, least significant first, MSB set on all bytes
+ * but the last one.
+ */
+#ifndef __OTA_PACKED_H__
+#define __OTA_PACKED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define OTA_PACKED_PORT         8070
+#define OTA_PACKED_MAGIC        "GZP1"
+#define OTA_FLAG_DELTA          0x01
+#define OTA_MAX_WINDOW_BITS     11
+
+/**
+ * Start the server receiving packed images.
+ */
+void ota_packed_init_server(uint16_t port);
+
+#endif // __OTA_PACKED_H__
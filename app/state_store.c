@@ -0,0 +1,225 @@
+#include "state_store.h"
+#include "ac_control.h"
+#include "esp_config.h"
+#include "metrics.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#include <espressif/spi_flash.h>
+
+/**
+ * The state is journaled in its own sectors (CONFIG_STATE_ADDR) so frequent
+ * state updates never touch the device configuration. Entries are appended
+ * to the erased flash, a sector is erased only when the journal moves to it
+ * while the other sector still holds the last state. The valid entry with
+ * the highest sequence number is the saved state.
+ */
+#define STATE_FLASH_ADDR    CONFIG_STATE_ADDR
+#define JOURNAL_MARKER      0x5A
+#define JOURNAL_ENTRIES     (CONFIG_STATE_SIZE / STATE_STORE_ENTRY_SIZE)
+#define SECTOR_ENTRIES      (SPI_FLASH_SEC_SIZE / STATE_STORE_ENTRY_SIZE)
+
+typedef struct {
+    uint8_t enabled;
+    uint8_t mode;
+    uint8_t temperature;
+    uint8_t fan_level;
+} StateRecord;
+
+typedef struct {
+    uint16_t seq;
+    uint8_t marker;     // JOURNAL_MARKER, 0xFF in erased entry
+    uint8_t checksum;
+    StateRecord record;
+} JournalEntry;
+
+// flash operations need 4 bytes alligned buffers
+typedef union {
+    JournalEntry entry;
+    uint32_t words[STATE_STORE_ENTRY_SIZE / 4];
+} JournalBuff;
+
+static StateRecord pending;
+static StateRecord saved;
+static uint32_t write_count = 0;
+static xSemaphoreHandle changed = NULL;
+static uint16_t next_entry = 0;
+static uint16_t next_seq = 0;
+
+static inline void fill_record(StateRecord *record, const MideaIR *ir)
+{
+    record->enabled = ir->enabled;
+    record->mode = ir->mode;
+    record->temperature = ir->temperature;
+    record->fan_level = ir->fan_level;
+}
+
+static bool record_valid(const StateRecord *record)
+{
+    MideaIR state;
+
+    state.enabled = record->enabled;
+    state.mode = record->mode;
+    state.temperature = record->temperature;
+    state.fan_level = record->fan_level;
+
+    return record->enabled <= 1 && ac_control_state_valid(&state);
+}
+
+static inline uint32_t entry_addr(uint16_t index)
+{
+    return STATE_FLASH_ADDR + index * STATE_STORE_ENTRY_SIZE;
+}
+
+static uint8_t entry_checksum(const JournalEntry *entry)
+{
+    const uint8_t *p = (const uint8_t*)entry;
+    uint8_t sum = 0;
+
+    for (uint8_t i = 0; i < sizeof(JournalEntry); i++) {
+        if (p + i != &entry->checksum) {
+            sum += p[i];
+        }
+    }
+    return ~sum;
+}
+
+static bool read_entry(uint16_t index, JournalBuff *buff)
+{
+    return sdk_spi_flash_read(entry_addr(index), buff->words,
+            STATE_STORE_ENTRY_SIZE) == SPI_FLASH_RESULT_OK;
+}
+
+static bool entry_erased(uint16_t index)
+{
+    JournalBuff buff;
+
+    return read_entry(index, &buff)
+        && buff.words[0] == 0xFFFFFFFF && buff.words[1] == 0xFFFFFFFF;
+}
+
+/**
+ * Find the last saved state and the place for the next entry.
+ */
+static bool read_record(StateRecord *record)
+{
+    bool found = false;
+
+    next_entry = 0;
+    next_seq = 0;
+    for (uint16_t i = 0; i < JOURNAL_ENTRIES; i++) {
+        JournalBuff buff;
+        JournalEntry *entry = &buff.entry;
+
+        if (!read_entry(i, &buff) || entry->marker != JOURNAL_MARKER
+                || entry->checksum != entry_checksum(entry)
+                || !record_valid(&entry->record)) {
+            continue;
+        }
+        if (!found || (int16_t)(entry->seq - next_seq) >= 0) {
+            found = true;
+            *record = entry->record;
+            next_seq = entry->seq + 1;
+            next_entry = (i + 1) % JOURNAL_ENTRIES;
+        }
+    }
+    return found;
+}
+
+static void write_record(StateRecord *record)
+{
+    JournalBuff buff;
+
+    buff.entry.seq = next_seq++;
+    buff.entry.marker = JOURNAL_MARKER;
+    buff.entry.record = *record;
+    buff.entry.checksum = entry_checksum(&buff.entry);
+
+    while (true) {
+        uint16_t index = next_entry;
+
+        next_entry = (next_entry + 1) % JOURNAL_ENTRIES;
+        if (index % SECTOR_ENTRIES == 0) {
+            sdk_spi_flash_erase_sector(entry_addr(index) / SPI_FLASH_SEC_SIZE);
+        } else if (!entry_erased(index)) {
+            continue;   // left by an interrupted write
+        }
+        sdk_spi_flash_write(entry_addr(index), buff.words,
+                STATE_STORE_ENTRY_SIZE);
+        break;
+    }
+    write_count++;
+}
+
+static void state_store_task(void *pvParams)
+{
+    StateRecord record;
+
+    while (true) {
+        xSemaphoreTake(changed, portMAX_DELAY);
+
+        // wait until updates settle down to coalesce them into one write,
+        // but not longer than the max delay since the first update
+        portTickType start = xTaskGetTickCount();
+        portTickType max_delay = STATE_STORE_MAX_DELAY_MS / portTICK_RATE_MS;
+        portTickType elapsed;
+        while ((elapsed = xTaskGetTickCount() - start) < max_delay) {
+            portTickType wait = STATE_STORE_DELAY_MS / portTICK_RATE_MS;
+            if (wait > max_delay - elapsed) {
+                wait = max_delay - elapsed;
+            }
+            if (xSemaphoreTake(changed, wait) != pdTRUE) {
+                break;
+            }
+        }
+
+        taskENTER_CRITICAL();
+        record = pending;
+        taskEXIT_CRITICAL();
+
+        if (memcmp(&record, &saved, sizeof(StateRecord))) {
+            write_record(&record);
+            saved = record;
+            printf("state saved, writes: %d\n", write_count);
+        }
+    }
+}
+
+void state_store_init(MideaIR *ir)
+{
+    if (read_record(&saved)) {
+        ir->enabled = saved.enabled;
+        ir->mode = saved.mode;
+        ir->temperature = saved.temperature;
+        ir->fan_level = saved.fan_level;
+        printf("state restored from flash\n");
+    } else {
+        fill_record(&saved, ir);
+        printf("no saved state, using defaults\n");
+    }
+    pending = saved;
+
+    changed = xSemaphoreCreateBinary();
+    xTaskHandle task = NULL;
+    xTaskCreate(state_store_task, (signed char *)"state", 256, NULL, 2, &task);
+    metrics_add_task("state", task);
+}
+
+void state_store_update(const MideaIR *ir)
+{
+    taskENTER_CRITICAL();
+    fill_record(&pending, ir);
+    taskEXIT_CRITICAL();
+
+    xSemaphoreGive(changed);
+}
+
+uint32_t state_store_get_write_count()
+{
+    return write_count;
+}
@@ -0,0 +1,51 @@
+/**
+ * The file implements write-behind persistence of the air conditioner state.
+ *
+ * The last applied state is journaled to flash so it can be restored right
+ * after reset. Each save appends a STATE_STORE_ENTRY_SIZE entry with a
+ * sequence number and a checksum to the state sectors, a sector is erased
+ * only when the journal wraps to it. An entry torn by a power loss is
+ * skipped and the previous state is restored.
+ *
+ * Updates are coalesced: the state is written only after it has been stable
+ * for STATE_STORE_DELAY_MS and only if it differs from what is already in
+ * flash.
+ */
+#ifndef __STATE_STORE_H__
+#define __STATE_STORE_H__
+
+#include <stdint.h>
+#include "midea-ir.h"
+
+/**
+ * Delay after the last update before the state is written to flash.
+ */
+#define STATE_STORE_DELAY_MS        5000
+
+/**
+ * Max time an update can be postponed by a steady stream of new updates.
+ */
+#define STATE_STORE_MAX_DELAY_MS    30000
+
+/**
+ * Size of a journal entry in flash.
+ */
+#define STATE_STORE_ENTRY_SIZE      8
+
+/**
+ * Restore the state saved in flash into 'ir' and start the write-behind task.
+ * Must be called after midea_ir_init.
+ */
+void state_store_init(MideaIR *ir);
+
+/**
+ * Schedule the state 'ir' to be written to flash.
+ */
+void state_store_update(const MideaIR *ir);
+
+/**
+ * Return the number of flash writes performed since boot.
+ */
+uint32_t state_store_get_write_count();
+
+#endif // __STATE_STORE_H__
@@ -0,0 +1,169 @@
+#include "udp_ctrl.h"
+#include "ac_control.h"
+#include "app_config.h"
+#include "metrics.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "esp/hwrand.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include <lwip/sockets.h>
+
+#define PACKET_BUFF_SIZE 64
+
+static uint32_t session;
+static uint32_t last_seq = 0;
+
+static const int wire_modes[] = {
+    [UDP_MODE_AUTO] = MODE_AUTO,
+    [UDP_MODE_COOL] = MODE_COOL,
+    [UDP_MODE_HEAT] = MODE_HEAT,
+    [UDP_MODE_FAN] = MODE_FAN,
+};
+
+static uint8_t to_wire_mode(int mode)
+{
+    for (uint8_t i = 0; i < sizeof(wire_modes) / sizeof(wire_modes[0]); i++) {
+        if (wire_modes[i] == mode) {
+            return i;
+        }
+    }
+    return 0xFF;
+}
+
+static void fill_status(UdpStatus *status, UdpResult result)
+{
+    MideaIR state;
+
+    ac_control_get(&state);
+
+    memset(status, 0, sizeof(UdpStatus));
+    status->result = result;
+    status->enabled = state.enabled;
+    status->mode = to_wire_mode(state.mode);
+    status->temperature = state.temperature;
+    status->fan_level = state.fan_level;
+    status->last_seq = last_seq;
+}
+
+static UdpResult execute(const UdpHeader *header, const UdpCommand *command)
+{
+    int value = command->value;
+    // unsigned difference, seq wraps around after 0xFFFFFFFF
+    uint32_t step = header->seq - last_seq;
+
+    if (header->session != session) {
+        return UDP_RESULT_BAD_SESSION;
+    }
+    if (step == 0 || step > 0x80000000) {
+        return UDP_RESULT_REPLAY;
+    }
+    if (step > UDP_CTRL_MAX_SEQ_STEP) {
+        return UDP_RESULT_BAD_SEQ;
+    }
+    if (command->cmd == AC_CMD_MODE) {
+        if (command->value >= sizeof(wire_modes) / sizeof(wire_modes[0])) {
+            return UDP_RESULT_BAD_COMMAND;
+        }
+        value = wire_modes[command->value];
+    }
+    last_seq = header->seq;
+
+    if (!ac_control_execute(command->cmd, value)) {
+        return UDP_RESULT_BAD_COMMAND;
+    }
+    return UDP_RESULT_OK;
+}
+
+/**
+ * Process request in 'buff' and put the reply to the same buffer.
+ * Return the reply length, 0 if there's no reply.
+ */
+static int process_packet(uint8_t *buff, int len)
+{
+    UdpHeader *header = (UdpHeader*)buff;
+    UdpStatus *status = (UdpStatus*)(buff + sizeof(UdpHeader));
+    UdpResult result = UDP_RESULT_OK;
+    int reply_len = sizeof(UdpHeader) + sizeof(UdpStatus);
+
+    if (len < (int)sizeof(UdpHeader) || header->magic[0] != 'G' ||
+            header->magic[1] != 'Z' || header->version != UDP_CTRL_VERSION) {
+        return 0;
+    }
+
+    switch (header->type) {
+        case UDP_DISCOVER:
+            fill_status(status, result);
+            snprintf((char*)buff + reply_len, PACKET_BUFF_SIZE - reply_len,
+                    "%s/%s", config_get_location(), config_get_name());
+            reply_len += strlen((char*)buff + reply_len) + 1;
+            header->type = UDP_ANNOUNCE;
+            break;
+        case UDP_GET_STATUS:
+            fill_status(status, result);
+            header->type = UDP_STATUS;
+            break;
+        case UDP_COMMAND:
+            if (len < (int)(sizeof(UdpHeader) + sizeof(UdpCommand))) {
+                return 0;
+            }
+            result = execute(header, (UdpCommand*)(buff + sizeof(UdpHeader)));
+            fill_status(status, result);
+            header->type = UDP_STATUS;
+            break;
+        default:
+            return 0;
+    }
+    header->session = session;
+
+    return reply_len;
+}
+
+static void udp_ctrl_task(void *pvParams)
+{
+    uint8_t buff[PACKET_BUFF_SIZE];
+    struct sockaddr_in addr;
+    socklen_t addr_len;
+
+    int sock = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        printf("UDP control socket error\n");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(UDP_CTRL_PORT);
+    if (lwip_bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        printf("UDP control bind error\n");
+        lwip_close(sock);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (true) {
+        addr_len = sizeof(addr);
+        int len = lwip_recvfrom(sock, buff, PACKET_BUFF_SIZE, 0,
+                (struct sockaddr*)&addr, &addr_len);
+        if (len <= 0) {
+            continue;
+        }
+
+        len = process_packet(buff, len);
+        if (len) {
+            lwip_sendto(sock, buff, len, 0, (struct sockaddr*)&addr, addr_len);
+        }
+    }
+}
+
+void udp_ctrl_init()
+{
+    session = hwrand();
+    xTaskHandle task = NULL;
+    xTaskCreate(udp_ctrl_task, (signed char *)"udp", 384, NULL, 3, &task);
+    metrics_add_task("udp", task);
+}
@@ -0,0 +1,103 @@
+/**
+ * The file implements local control of the device over UDP.
+ *
+ * Packet structure, all fields are little endian:
+ *
+ *  2 bytes   1 byte    1 byte  4 bytes   4 bytes
+ * +--------+---------+------+---------+-----+-----------------+
+ * | "GZ"   | version | type | session | seq |     payload     |
+ * +--------+---------+------+---------+-----+-----------------+
+ *
+ * Packet types:
+ *  - DISCOVER (client -> broadcast), no payload. Any session and seq.
+ *    The device replies with ANNOUNCE.
+ *  - ANNOUNCE (device -> client), payload is UdpStatus followed by
+ *    zero terminated string "location/name".
+ *  - GET_STATUS (client -> device), no payload. Any session and seq.
+ *    The device replies with STATUS.
+ *  - COMMAND (client -> device), payload is UdpCommand.
+ *    The device replies with STATUS.
+ *  - STATUS (device -> client), payload is UdpStatus.
+ *
+ * Replies carry the device session and the seq of the request.
+ * The session is a random number generated on boot. A command is accepted
+ * only if its session matches the device session and its seq is ahead of
+ * the seq of the last accepted command (UdpStatus.last_seq) by 1 to
+ * UDP_CTRL_MAX_SEQ_STEP. This protects the device from replayed packets
+ * (UDP_RESULT_REPLAY). A seq further ahead is rejected with
+ * UDP_RESULT_BAD_SEQ and doesn't change last_seq, so a buggy client can't
+ * lock out the others. Seq is compared modulo 2^32, after 0xFFFFFFFF the
+ * next seq is 0. A client obtains the session and the last seq from
+ * ANNOUNCE or STATUS and continues from there after any error.
+ */
+#ifndef __UDP_CTRL_H__
+#define __UDP_CTRL_H__
+
+#include <stdint.h>
+
+#define UDP_CTRL_PORT       4210
+#define UDP_CTRL_VERSION    1
+
+/**
+ * Max distance of a command seq ahead of the last accepted seq.
+ */
+#define UDP_CTRL_MAX_SEQ_STEP   1024
+
+typedef enum {
+    UDP_DISCOVER = 1,
+    UDP_ANNOUNCE,
+    UDP_GET_STATUS,
+    UDP_COMMAND,
+    UDP_STATUS,
+} UdpPacketType;
+
+typedef enum {
+    UDP_RESULT_OK = 0,
+    UDP_RESULT_BAD_SESSION,
+    UDP_RESULT_REPLAY,
+    UDP_RESULT_BAD_COMMAND,
+    UDP_RESULT_BAD_SEQ,
+} UdpResult;
+
+/**
+ * Modes on the wire, independent of the IR library values.
+ */
+typedef enum {
+    UDP_MODE_AUTO = 0,
+    UDP_MODE_COOL,
+    UDP_MODE_HEAT,
+    UDP_MODE_FAN,
+} UdpMode;
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic[2];
+    uint8_t version;
+    uint8_t type;
+    uint32_t session;
+    uint32_t seq;
+} UdpHeader;
+
+/**
+ * 'cmd' is one of AcCommand values, for AC_CMD_MODE 'value' is UdpMode.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t cmd;
+    uint8_t value;
+} UdpCommand;
+
+typedef struct __attribute__((packed)) {
+    uint8_t result;
+    uint8_t enabled;
+    uint8_t mode;
+    uint8_t temperature;
+    uint8_t fan_level;
+    uint8_t reserved[3];
+    uint32_t last_seq;
+} UdpStatus;
+
+/**
+ * Start UDP control server on UDP_CTRL_PORT.
+ */
+void udp_ctrl_init();
+
+#endif // __UDP_CTRL_H__
@@ -0,0 +1,211 @@
+#include "wifi_conn.h"
+#include "app_config.h"
+#include "esp_config.h"
+#include "metrics.h"
+#include "espressif/esp_common.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#include <espressif/spi_flash.h>
+
+/**
+ * The cache is kept in its own sector (CONFIG_WIFI_CACHE_ADDR).
+ */
+#define CACHE_FLASH_ADDR    CONFIG_WIFI_CACHE_ADDR
+#define CACHE_ITEM_ID       0
+
+typedef enum {
+    CONN_IDLE = 0,
+    CONN_FAST,      // connecting to the cached AP with the cached IP
+    CONN_FULL,      // connecting with a full scan and DHCP
+    CONN_READY,
+} ConnState;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ip;
+    uint32_t netmask;
+    uint32_t gw;
+} WifiCache;
+
+static ConnState state = CONN_IDLE;
+static bool from_cache = false;
+static WifiCache cache;
+
+static bool read_cache()
+{
+    ConfigItem item = {CACHE_ITEM_ID, 0, 0};
+    bool result = false;
+
+    if (config_read_from(CACHE_FLASH_ADDR, &item, 1) == 1) {
+        if (item.id == CACHE_ITEM_ID && item.length == sizeof(WifiCache)) {
+            memcpy(&cache, item.data, sizeof(WifiCache));
+            result = cache.channel >= 1 && cache.channel <= 14 && cache.ip;
+        }
+        config_free(&item, 1);
+    }
+    return result;
+}
+
+static void write_cache(WifiCache *data)
+{
+    ConfigItem item = {CACHE_ITEM_ID, (char*)data, sizeof(WifiCache)};
+
+    config_write_to(CACHE_FLASH_ADDR, &item, 1);
+}
+
+/**
+ * Erase the cache sector, the next boot makes a full connect.
+ */
+static void erase_cache()
+{
+    sdk_spi_flash_erase_sector(CACHE_FLASH_ADDR / SPI_FLASH_SEC_SIZE);
+    memset(&cache, 0, sizeof(WifiCache));
+}
+
+static inline void fill_station_config(struct sdk_station_config *config)
+{
+    memset(config, 0, sizeof(struct sdk_station_config));
+    strcpy((char*)config->ssid, config_get_ssid());
+    strcpy((char*)config->password, config_get_ssid_pass());
+}
+
+static void start_fast()
+{
+    struct sdk_station_config config;
+    struct ip_info info;
+
+    printf("WiFi fast connect, channel %d\n", cache.channel);
+
+    fill_station_config(&config);
+    config.bssid_set = 1;
+    memcpy(config.bssid, cache.bssid, 6);
+
+    sdk_wifi_station_dhcpc_stop();
+    info.ip.addr = cache.ip;
+    info.netmask.addr = cache.netmask;
+    info.gw.addr = cache.gw;
+    sdk_wifi_set_ip_info(STATION_IF, &info);
+
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_set_channel(cache.channel);
+    sdk_wifi_station_connect();
+
+    from_cache = true;
+    state = CONN_FAST;
+}
+
+static void start_full()
+{
+    struct sdk_station_config config;
+
+    printf("WiFi connect with full scan\n");
+
+    fill_station_config(&config);
+
+    sdk_wifi_station_disconnect();
+    sdk_wifi_station_dhcpc_start();
+    sdk_wifi_station_set_config(&config);
+    sdk_wifi_station_connect();
+
+    from_cache = false;
+    state = CONN_FULL;
+}
+
+/**
+ * Save parameters of the current connection if they differ from the cached
+ * ones. The station config holds the BSSID of the AP it is connected to.
+ */
+static void update_cache()
+{
+    struct sdk_station_config config;
+    struct ip_info info;
+    WifiCache current;
+
+    sdk_wifi_get_ip_info(STATION_IF, &info);
+    if (!info.ip.addr) {
+        return;
+    }
+
+    sdk_wifi_station_get_config(&config);
+    memset(&current, 0, sizeof(WifiCache));
+    memcpy(current.bssid, config.bssid, 6);
+    current.channel = sdk_wifi_get_channel();
+    current.ip = info.ip.addr;
+    current.netmask = info.netmask.addr;
+    current.gw = info.gw.addr;
+
+    if (memcmp(&current, &cache, sizeof(WifiCache))) {
+        cache = current;
+        write_cache(&cache);
+        printf("WiFi cache updated\n");
+    }
+}
+
+void wifi_conn_start()
+{
+    sdk_wifi_set_opmode(STATION_MODE);
+
+    if (read_cache()) {
+        start_fast();
+    } else {
+        memset(&cache, 0, sizeof(WifiCache));
+        start_full();
+    }
+}
+
+void wifi_conn_wait()
+{
+    portTickType start = xTaskGetTickCount();
+
+    while (sdk_wifi_station_get_connect_status() != STATION_GOT_IP) {
+        if (state == CONN_READY) {
+            // connection lost, the station reconnects by itself
+            printf("Not connected\n");
+            state = from_cache ? CONN_FAST : CONN_FULL;
+            start = xTaskGetTickCount();
+        }
+
+        if (state == CONN_FAST && xTaskGetTickCount() - start >
+                WIFI_FAST_CONNECT_TIMEOUT_MS / portTICK_RATE_MS) {
+            printf("WiFi fast connect timeout\n");
+            start_full();
+        }
+
+        vTaskDelay(WIFI_POLL_MS / portTICK_RATE_MS);
+    }
+
+    if (state == CONN_FAST) {
+        // The cached address is only used to get connected without waiting
+        // for DHCP. The lease is renewed right away, so the address is not
+        // given to another host. The station keeps the address until DHCP
+        // binds a lease.
+        sdk_wifi_station_dhcpc_start();
+    } else if (state == CONN_FULL) {
+        update_cache();
+    }
+    state = CONN_READY;
+    metrics_mark_wifi_ready();
+}
+
+void wifi_conn_check()
+{
+    if (state == CONN_READY &&
+            sdk_wifi_station_get_connect_status() == STATION_GOT_IP) {
+        update_cache();
+    }
+}
+
+void wifi_conn_invalidate()
+{
+    if (from_cache) {
+        printf("WiFi cache invalidated\n");
+        erase_cache();
+        start_full();
+    }
+}
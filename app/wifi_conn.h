@@ -0,0 +1,49 @@
+/**
+ * The file implements WiFi station connection with fast reassociation.
+ *
+ * The BSSID, channel and IP settings of the last successful connection are
+ * cached in flash. On the next boot the station connects directly to the
+ * cached access point with the cached IP, skipping the channel scan and DHCP.
+ * If that fails within WIFI_FAST_CONNECT_TIMEOUT_MS the regular connection
+ * with a full scan and DHCP is used. After a fast connect DHCP is started to
+ * renew the lease of the cached address.
+ *
+ * The connection status is polled every WIFI_POLL_MS, the SDK in
+ * esp-open-rtos does not provide WiFi event callbacks.
+ */
+#ifndef __WIFI_CONN_H__
+#define __WIFI_CONN_H__
+
+#include <stdbool.h>
+
+#define WIFI_FAST_CONNECT_TIMEOUT_MS    3000
+#define WIFI_POLL_MS                    50
+
+/**
+ * Configure the station and start connecting.
+ */
+void wifi_conn_start();
+
+/**
+ * Block until the station is connected and has an IP address.
+ */
+void wifi_conn_wait();
+
+/**
+ * Update the cache if the connection parameters have changed, e.g. DHCP gave
+ * a new address after a fast connect. Should be called periodically while
+ * connected. Flash is written only when something has changed.
+ */
+void wifi_conn_check();
+
+/**
+ * Erase the cached connection parameters and reconnect with a full scan.
+ * The cache is written again once the full connect succeeds, until then
+ * the device connects with a full scan after reboot too.
+ * Should be called when the network is not usable with the cached settings,
+ * e.g. the IP lease has been given to another host.
+ * Does nothing if the connection was not made from the cache.
+ */
+void wifi_conn_invalidate();
+
+#endif // __WIFI_CONN_H__
@@ -82,7 +82,7 @@ static inline void *alligned_malloc(size_t size, uint8_t *offset)
 {
     char *buff = (char*)malloc(size + 3);  // need extra 3 bytes to allign buffer
     
-    *offset = (uint32_t)buff % 4;
+    *offset = (uintptr_t)buff % 4;
     if (*offset) {
         printf("malloc misalligned\n");
     }
@@ -113,14 +113,14 @@ static uint16_t calculate_checksum(const char *data, uint8_t size)
     return sum;
 }
 
-static inline uint16_t read_main_header()
+static inline uint16_t read_main_header(uint32_t base_addr)
 {
     uint16_t length = 0;
     uint8_t offset;
     MainHeader *header = (MainHeader*)alligned_malloc(
             sizeof(MainHeader), &offset);
 
-    if (sdk_spi_flash_read(CONFIG_FLASH_BASE_ADDR, header, sizeof(MainHeader)) 
+    if (sdk_spi_flash_read(base_addr, header, sizeof(MainHeader)) 
             != SPI_FLASH_RESULT_OK) {
         printf("SPI flash read error\n");
     }
@@ -192,12 +192,16 @@ uint8_t read_data_item(uint32_t addr, ConfigItem *item)
     }
 }
 
-uint8_t config_read(ConfigItem *items, uint8_t size)
+uint8_t config_read_from(uint32_t base_addr, ConfigItem *items, uint8_t size)
 {
-    uint32_t addr = CONFIG_FLASH_BASE_ADDR + sizeof(MainHeader);
-    uint16_t data_length = read_main_header();
+    uint32_t addr = base_addr + sizeof(MainHeader);
+    uint16_t data_length = read_main_header(base_addr);
     uint8_t counter = 0;
 
+    if (!data_length) {  // nothing has been written yet
+        return 0;
+    }
+
     for (uint8_t i = 0; i < size; i++) {
         uint8_t read_bytes = read_data_item(addr, &items[i]);
         if (read_bytes) {
@@ -220,6 +224,11 @@ uint8_t config_read(ConfigItem *items, uint8_t size)
     return counter;
 }
 
+uint8_t config_read(ConfigItem *items, uint8_t size)
+{
+    return config_read_from(CONFIG_FLASH_BASE_ADDR, items, size);
+}
+
 static inline uint16_t total_data_length(ConfigItem *items, uint8_t size)
 {
     uint16_t total = 0;
@@ -229,7 +238,7 @@ static inline uint16_t total_data_length(ConfigItem *items, uint8_t size)
     return total;
 }
 
-static inline void write_main_header(uint16_t length)
+static inline void write_main_header(uint32_t base_addr, uint16_t length)
 {
     uint8_t offset;
     MainHeader *header = (MainHeader*)alligned_malloc(
@@ -238,7 +247,7 @@ static inline void write_main_header(uint16_t length)
     header->signature = SIGNATURE_CONST;
     header->length = length;
 
-    sdk_spi_flash_write(CONFIG_FLASH_BASE_ADDR, header, sizeof(header));
+    sdk_spi_flash_write(base_addr, header, sizeof(MainHeader));
 
     alligned_free(header, offset);
 }
@@ -262,19 +271,24 @@ static inline uint8_t write_data_item(uint32_t addr, ConfigItem *item)
     return buff_size;
 }
 
-void config_write(ConfigItem *items, uint8_t size)
+void config_write_to(uint32_t base_addr, ConfigItem *items, uint8_t size)
 {
-    uint32_t addr = CONFIG_FLASH_BASE_ADDR + sizeof(MainHeader);
+    uint32_t addr = base_addr + sizeof(MainHeader);
     sdk_spi_flash_erase_sector(addr / SPI_FLASH_SEC_SIZE);
 
     uint16_t length = total_data_length(items, size);
-    write_main_header(length);
+    write_main_header(base_addr, length);
 
     for (uint8_t i = 0; i < size; i++) {
         addr += write_data_item(addr, &items[i]);
     }
 }
 
+void config_write(ConfigItem *items, uint8_t size)
+{
+    config_write_to(CONFIG_FLASH_BASE_ADDR, items, size);
+}
+
 void config_free(ConfigItem *items, uint8_t size)
 {
     for (uint8_t i = 0; i < size; i++) {
@@ -9,6 +9,19 @@
 
 #define CONFIG_FLASH_BASE_ADDR   0xE0000
 #define CONFIG_FLASH_SIZE        0x1FFFF
+#define CONFIG_SECTOR_SIZE       0x1000
+
+/**
+ * Application data follows the main config, each area in its own sectors.
+ * CONFIG_APP_DATA_SIZE covers the main config and all the areas, the flash
+ * from CONFIG_FLASH_BASE_ADDR up to it must not be used for anything else.
+ */
+#define CONFIG_STATE_ADDR        (CONFIG_FLASH_BASE_ADDR + CONFIG_SECTOR_SIZE)
+#define CONFIG_STATE_SIZE        (2 * CONFIG_SECTOR_SIZE)
+#define CONFIG_WIFI_CACHE_ADDR   (CONFIG_STATE_ADDR + CONFIG_STATE_SIZE)
+#define CONFIG_WIFI_CACHE_SIZE   CONFIG_SECTOR_SIZE
+#define CONFIG_APP_DATA_SIZE     (CONFIG_WIFI_CACHE_ADDR \
+        + CONFIG_WIFI_CACHE_SIZE - CONFIG_FLASH_BASE_ADDR)
 
 typedef struct {
     uint8_t id; 
@@ -21,6 +34,13 @@ typedef struct {
  */
 void config_write(ConfigItem *items, uint8_t size);
 
+/**
+ * Same as config_write but the data is stored at 'base_addr'.
+ * The address must be the beginning of a flash sector. The whole sector
+ * is erased before writing.
+ */
+void config_write_to(uint32_t base_addr, ConfigItem *items, uint8_t size);
+
 /**
  * Read config items from the flash. Read max 'size' items.
  * For each item the function will allocate memory for the data
@@ -32,6 +52,11 @@ void config_write(ConfigItem *items, uint8_t size);
  */
 uint8_t config_read(ConfigItem *items, uint8_t size);
 
+/**
+ * Same as config_read but the data is read from 'base_addr'.
+ */
+uint8_t config_read_from(uint32_t base_addr, ConfigItem *items, uint8_t size);
+
 /**
  * Free the memory that was allocated during reading.
  * This function also sets items[n].data to 0.
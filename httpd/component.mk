@@ -0,0 +1,6 @@
+
+INC_DIRS += $(httpd_ROOT)
+
+httpd_SRC_DIR = $(httpd_ROOT)
+
+$(eval $(call component_compile_rules,httpd))
@@ -0,0 +1,689 @@
+/**
+ * The file implements a simple http server with persistent connections.
+ */
+#include "httpd.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "lwip/sockets.h"
+
+// room for the response header in front of the body in the tx buffer
+#define HTTPD_TX_RESERVE        160
+#define HTTPD_SELECT_TIMEOUT_MS 1000
+
+typedef enum {
+    BODY_SKIP = 0,
+    BODY_URLENCODED,
+    BODY_MULTIPART,
+} BodyType;
+
+typedef enum {
+    PART_PREAMBLE = 0,
+    PART_DELIMITER,
+    PART_HEADERS,
+    PART_DATA,
+    PART_END,
+} PartState;
+
+static const char *status_text(uint16_t status)
+{
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 500: return "Internal Server Error";
+        default: return "Unknown";
+    }
+}
+
+static char *find(char *buff, int len, const char *pattern, int pattern_len)
+{
+    for (int i = 0; i + pattern_len <= len; i++) {
+        if (buff[i] == pattern[0]
+                && memcmp(buff + i, pattern, pattern_len) == 0) {
+            return buff + i;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Find a header value within the header block.
+ * Returns a pointer to the value, which ends at the end of the line.
+ */
+static const char *find_header(const char *headers, int len,
+        const char *name)
+{
+    int name_len = strlen(name);
+    const char *end = headers + len;
+    const char *line = headers;
+
+    while (line < end) {
+        const char *eol = memchr(line, '\n', end - line);
+        if (!eol) {
+            break;
+        }
+        if (eol - line > name_len && line[name_len] == ':'
+                && strncasecmp(line, name, name_len) == 0) {
+            const char *value = line + name_len + 1;
+            while (*value == ' ') {
+                value++;
+            }
+            return value;
+        }
+        line = eol + 1;
+    }
+    return NULL;
+}
+
+static bool value_has(const char *value, const char *token)
+{
+    int len = strlen(token);
+
+    for (; *value; value++) {
+        if (strncasecmp(value, token, len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool send_all(int sock, const char *data, int len)
+{
+    while (len > 0) {
+        int sent = lwip_send(sock, data, len, 0);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+static int format_header(Httpd *httpd, char *buff, int size, int length)
+{
+    uint16_t status = httpd->status ? httpd->status : 404;
+    const char *content_type = httpd->content_type ?
+        httpd->content_type : "text/html";
+    int len;
+
+    len = snprintf(buff, size, "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n",
+            status, status_text(status), content_type);
+    if (length >= 0) {
+        len += snprintf(buff + len, size - len, "Content-Length: %d\r\n",
+                length);
+    }
+    len += snprintf(buff + len, size - len, "Connection: %s\r\n\r\n",
+            httpd->keep_alive ? "keep-alive" : "close");
+    return len;
+}
+
+static void begin_response(Httpd *httpd, HttpdConnection *conn,
+        bool keep_alive)
+{
+    httpd->current = conn;
+    httpd->tx_len = HTTPD_TX_RESERVE;
+    httpd->status = 0;
+    httpd->content_type = NULL;
+    httpd->keep_alive = keep_alive;
+    httpd->streaming = false;
+}
+
+static bool finish_response(Httpd *httpd)
+{
+    char header[HTTPD_TX_RESERVE];
+    int body_len = httpd->tx_len - HTTPD_TX_RESERVE;
+    int len;
+
+    if (httpd->streaming) {
+        return false;
+    }
+
+    len = format_header(httpd, header, sizeof(header), body_len);
+    memcpy(httpd->tx + HTTPD_TX_RESERVE - len, header, len);
+    return send_all(httpd->current->sock,
+            httpd->tx + HTTPD_TX_RESERVE - len, len + body_len);
+}
+
+void httpd_send_status(Httpd *httpd, uint16_t status,
+        const char *content_type)
+{
+    httpd->status = status;
+    httpd->content_type = content_type;
+}
+
+void httpd_send_header(Httpd *httpd, bool ok)
+{
+    httpd_send_status(httpd, ok ? 200 : 404, "text/html");
+}
+
+void httpd_send_data(Httpd *httpd, const void *data, uint16_t len)
+{
+    if (!httpd->streaming && httpd->tx_len + len <= HTTPD_TX_BUFF_SIZE) {
+        memcpy(httpd->tx + httpd->tx_len, data, len);
+        httpd->tx_len += len;
+        return;
+    }
+
+    if (!httpd->streaming) {
+        // The body doesn't fit, send it without Content-Length and
+        // close the connection after the response
+        char header[HTTPD_TX_RESERVE];
+        int header_len;
+
+        httpd->streaming = true;
+        httpd->keep_alive = false;
+        header_len = format_header(httpd, header, sizeof(header), -1);
+        send_all(httpd->current->sock, header, header_len);
+        send_all(httpd->current->sock, httpd->tx + HTTPD_TX_RESERVE,
+                httpd->tx_len - HTTPD_TX_RESERVE);
+    }
+    send_all(httpd->current->sock, data, len);
+}
+
+static int url_decode(char *data, int len)
+{
+    int out = 0;
+
+    for (int i = 0; i < len; i++) {
+        if (data[i] == '+') {
+            data[out++] = ' ';
+        } else if (data[i] == '%' && i + 2 < len
+                && isxdigit((int)data[i + 1])
+                && isxdigit((int)data[i + 2])) {
+            char hex[3] = {data[i + 1], data[i + 2], 0};
+            data[out++] = strtol(hex, NULL, 16);
+            i += 2;
+        } else {
+            data[out++] = data[i];
+        }
+    }
+    return out;
+}
+
+/**
+ * Mark the body as malformed, the rest of it is skipped.
+ * Returns 'len' so the caller consumes the received data.
+ */
+static int body_error(Httpd *httpd, int len)
+{
+    httpd->body_type = BODY_SKIP;
+    httpd->body_result = false;
+    return len;
+}
+
+/**
+ * The body parsers below get the received part of the body. 'last' is set
+ * if it is the rest of the body, 'stuck' is set if the receive buffer is
+ * full so the parser must consume something. They return the number of
+ * consumed bytes, the rest is passed again with more data.
+ */
+static int parse_urlencoded(Httpd *httpd, char *data, int len, bool last,
+        bool stuck)
+{
+    char *p = data;
+    char *end = data + len;
+
+    while (p < end) {
+        char *next = memchr(p, '&', end - p);
+        char *eq;
+
+        if (!next) {
+            if (!last) {
+                // wait for the rest of the field
+                return stuck ? body_error(httpd, len) : p - data;
+            }
+            next = end;
+        }
+        eq = memchr(p, '=', next - p);
+        if (eq) {
+            *eq = 0;
+            url_decode(p, eq - p + 1);
+            httpd->data_handler(httpd, p, eq + 1,
+                    url_decode(eq + 1, next - eq - 1));
+        }
+        p = next < end ? next + 1 : end;
+    }
+    return len;
+}
+
+static int parse_multipart(Httpd *httpd, char *data, int len, bool last,
+        bool stuck)
+{
+    char *p = data;
+    char *end = data + len;
+
+    while (true) {
+        char *found;
+
+        switch (httpd->part_state) {
+            case PART_PREAMBLE:
+                // the first delimiter is not preceded by CRLF
+                found = find(p, end - p, httpd->delim + 2,
+                        httpd->delim_len - 2);
+                if (!found) {
+                    return last || stuck ? body_error(httpd, len) : p - data;
+                }
+                p = found + httpd->delim_len - 2;
+                httpd->part_state = PART_DELIMITER;
+                break;
+            case PART_DELIMITER:
+                if (end - p < 2) {
+                    return last ? body_error(httpd, len) : p - data;
+                }
+                if (p[0] == '-' && p[1] == '-') {
+                    httpd->part_state = PART_END;
+                } else if (p[0] == '\r' && p[1] == '\n') {
+                    httpd->part_state = PART_HEADERS;
+                } else {
+                    return body_error(httpd, len);
+                }
+                p += 2;
+                break;
+            case PART_HEADERS:
+                found = find(p, end - p, "\r\n\r\n", 4);
+                if (!found) {
+                    return last || (stuck && p == data) ?
+                        body_error(httpd, len) : p - data;
+                }
+                *found = 0;
+                httpd->field[0] = 0;
+                p = strstr(p, " name=\"");
+                if (p) {
+                    char *quote;
+
+                    p += strlen(" name=\"");
+                    quote = strchr(p, '"');
+                    if (quote && quote - p < HTTPD_FIELD_NAME_SIZE) {
+                        memcpy(httpd->field, p, quote - p);
+                        httpd->field[quote - p] = 0;
+                    }
+                }
+                p = found + 4;
+                httpd->part_state = PART_DATA;
+                break;
+            case PART_DATA:
+                found = find(p, end - p, httpd->delim, httpd->delim_len);
+                if (!found) {
+                    char *chunk_end;
+
+                    if (last) {
+                        return body_error(httpd, len);
+                    }
+                    if (!stuck || p != data) {
+                        return p - data;    // try with more data
+                    }
+                    // pass a chunk of a large field, keep the tail that
+                    // may be the beginning of the delimiter
+                    chunk_end = end - (httpd->delim_len - 1);
+                    if (httpd->field[0]) {
+                        httpd->data_handler(httpd, httpd->field, p,
+                                chunk_end - p);
+                    }
+                    return chunk_end - data;
+                }
+                if (httpd->field[0]) {
+                    httpd->data_handler(httpd, httpd->field, p, found - p);
+                }
+                p = found + httpd->delim_len;
+                httpd->part_state = PART_DELIMITER;
+                break;
+            default:
+                return len;     // epilogue
+        }
+    }
+}
+
+static void begin_body(Httpd *httpd, const char *content_type,
+        int content_length)
+{
+    const char *b;
+    int i;
+
+    httpd->body_left = content_length;
+    httpd->body_result = true;
+    httpd->body_type = BODY_SKIP;
+
+    if (content_length == 0) {
+        return;
+    }
+    if (httpd->method != HTTP_POST || !content_type) {
+        httpd->body_result = false;
+        return;
+    }
+    if (strncasecmp(content_type, "application/x-www-form-urlencoded",
+                strlen("application/x-www-form-urlencoded")) == 0) {
+        httpd->body_type = BODY_URLENCODED;
+        return;
+    }
+    b = strstr(content_type, "boundary=");
+    if (strncasecmp(content_type, "multipart/form-data",
+                strlen("multipart/form-data")) || !b) {
+        httpd->body_result = false;
+        return;
+    }
+
+    b += strlen("boundary=");
+    if (*b == '"') {
+        b++;
+    }
+    strcpy(httpd->delim, "\r\n--");
+    for (i = 4; *b && *b != '"' && *b != ';'
+            && i < HTTPD_BOUNDARY_SIZE - 1; i++) {
+        httpd->delim[i] = *b++;
+    }
+    httpd->delim[i] = 0;
+    httpd->delim_len = i;
+    httpd->part_state = PART_PREAMBLE;
+    httpd->body_type = BODY_MULTIPART;
+}
+
+static void close_connection(Httpd *httpd, HttpdConnection *conn)
+{
+    if (httpd->body_conn == conn) {
+        // the request is not complete, let the handler clean up
+        httpd->body_conn = NULL;
+        if (httpd->method == HTTP_POST) {
+            httpd->data_complete_handler(httpd, false);
+        }
+    }
+    lwip_close(conn->sock);
+    conn->sock = -1;
+    conn->rx_len = 0;
+    free(conn->rx);
+    conn->rx = NULL;
+}
+
+static void reply_error(Httpd *httpd, HttpdConnection *conn, uint16_t status)
+{
+    begin_response(httpd, conn, false);
+    httpd_send_status(httpd, status, "text/html");
+    finish_response(httpd);
+    close_connection(httpd, conn);
+}
+
+/**
+ * Send the response.
+ * Returns true if the connection remains open for the next request.
+ */
+static bool finish_request(Httpd *httpd, HttpdConnection *conn)
+{
+    if (!finish_response(httpd) || !httpd->keep_alive) {
+        close_connection(httpd, conn);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Pass the received part of the request body to the handlers.
+ * Returns true if the request is complete and the connection remains open.
+ */
+static bool receive_body(Httpd *httpd, HttpdConnection *conn)
+{
+    int len = conn->rx_len < httpd->body_left ?
+        conn->rx_len : httpd->body_left;
+    bool last = len == httpd->body_left;
+    bool stuck = conn->rx_len == HTTPD_RX_BUFF_SIZE;
+    int used;
+
+    switch (httpd->body_type) {
+        case BODY_URLENCODED:
+            used = parse_urlencoded(httpd, conn->rx, len, last, stuck);
+            break;
+        case BODY_MULTIPART:
+            used = parse_multipart(httpd, conn->rx, len, last, stuck);
+            break;
+        default:
+            used = len;
+    }
+    httpd->body_left -= used;
+    conn->rx_len -= used;
+    memmove(conn->rx, conn->rx + used, conn->rx_len);
+
+    if (httpd->body_left) {
+        return false;   // wait for more data
+    }
+
+    httpd->body_conn = NULL;
+    if (httpd->method == HTTP_POST) {
+        if (httpd->body_type == BODY_MULTIPART
+                && httpd->part_state != PART_END) {
+            httpd->body_result = false;
+        }
+        httpd->data_complete_handler(httpd, httpd->body_result);
+    }
+    return finish_request(httpd, conn);
+}
+
+/**
+ * Handle the request headers from the receive buffer and start receiving
+ * the body.
+ * Returns true if the request is complete and the buffer can contain
+ * another request.
+ */
+static bool process_request(Httpd *httpd, HttpdConnection *conn)
+{
+    char *rx = conn->rx;
+    char *headers_end = find(rx, conn->rx_len, "\r\n\r\n", 4);
+    const char *value;
+    const char *content_type;
+    int header_len, content_length = 0;
+    bool keep_alive;
+    char *url, *p;
+
+    if (!headers_end) {
+        if (conn->rx_len == HTTPD_RX_BUFF_SIZE) {
+            reply_error(httpd, conn, 413);
+        }
+        return false;
+    }
+    header_len = headers_end - rx + 4;
+
+    // terminate header lines so the values can be used as strings
+    for (p = rx; p <= headers_end; p++) {
+        if (*p == '\r') {
+            *p = 0;
+        }
+    }
+    value = find_header(rx, header_len, "Content-Length");
+    if (value) {
+        content_length = atoi(value);
+    }
+    content_type = find_header(rx, header_len, "Content-Type");
+    value = find_header(rx, header_len, "Connection");
+
+    // Request line: METHOD URL VERSION
+    if (strncmp(rx, "GET ", 4) == 0) {
+        httpd->method = HTTP_GET;
+    } else if (strncmp(rx, "POST ", 5) == 0) {
+        httpd->method = HTTP_POST;
+    } else {
+        httpd->method = HTTP_UNKNOWN;
+    }
+    url = strchr(rx, ' ');
+    if (!url || content_length < 0) {
+        reply_error(httpd, conn, 400);
+        return false;
+    }
+    url++;
+    p = strchr(url, ' ');
+    keep_alive = p && strcmp(p + 1, "HTTP/1.1") == 0;
+    if (p) {
+        *p = 0;
+    }
+    p = strchr(url, '?');
+    if (p) {
+        *p = 0;     // query is not used
+    }
+    if (value) {
+        if (value_has(value, "close")) {
+            keep_alive = false;
+        } else if (value_has(value, "keep-alive")) {
+            keep_alive = true;
+        }
+    }
+
+    begin_response(httpd, conn, keep_alive);
+    httpd->req_handler(httpd, url, httpd->method);
+
+    // the headers are not needed any more, the boundary is copied
+    begin_body(httpd, content_type, content_length);
+    conn->rx_len -= header_len;
+    memmove(rx, rx + header_len, conn->rx_len);
+    httpd->body_conn = conn;
+    return receive_body(httpd, conn);
+}
+
+static void accept_connection(Httpd *httpd, int listen_sock)
+{
+    HttpdConnection *conn = NULL;
+    int sock = lwip_accept(listen_sock, NULL, NULL);
+    int opt = 1;
+
+    if (sock < 0) {
+        return;
+    }
+
+    for (int i = 0; i < HTTPD_MAX_CONNECTIONS; i++) {
+        if (httpd->conn[i].sock < 0) {
+            conn = &httpd->conn[i];
+            break;
+        }
+    }
+    if (!conn) {
+        // replace the least recently used connection without pending data
+        for (int i = 0; i < HTTPD_MAX_CONNECTIONS; i++) {
+            HttpdConnection *c = &httpd->conn[i];
+            if (!c->rx_len && (!conn
+                        || (int32_t)(c->last_active - conn->last_active) < 0)) {
+                conn = c;
+            }
+        }
+        if (!conn) {
+            lwip_close(sock);
+            return;
+        }
+        close_connection(httpd, conn);
+    }
+
+    conn->rx = malloc(HTTPD_RX_BUFF_SIZE);
+    if (!conn->rx) {
+        printf("httpd: not enough memory\n");
+        lwip_close(sock);
+        return;
+    }
+    lwip_setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    conn->sock = sock;
+    conn->rx_len = 0;
+    conn->last_active = xTaskGetTickCount();
+}
+
+static void receive(Httpd *httpd, HttpdConnection *conn)
+{
+    int len = lwip_recv(conn->sock, conn->rx + conn->rx_len,
+            HTTPD_RX_BUFF_SIZE - conn->rx_len, 0);
+
+    if (len <= 0) {
+        close_connection(httpd, conn);
+        return;
+    }
+    conn->rx_len += len;
+    conn->last_active = xTaskGetTickCount();
+
+    if (httpd->body_conn == conn && !receive_body(httpd, conn)) {
+        return;
+    }
+    while (conn->sock >= 0 && process_request(httpd, conn)) {
+    }
+}
+
+void httpd_init(Httpd *httpd)
+{
+    for (int i = 0; i < HTTPD_MAX_CONNECTIONS; i++) {
+        httpd->conn[i].sock = -1;
+        httpd->conn[i].rx = NULL;
+        httpd->conn[i].rx_len = 0;
+    }
+    httpd->current = NULL;
+    httpd->body_conn = NULL;
+    httpd->tx = malloc(HTTPD_TX_BUFF_SIZE);
+}
+
+void httpd_serve(Httpd *httpd, uint16_t port)
+{
+    struct sockaddr_in addr;
+    int listen_sock;
+    int opt = 1;
+
+    listen_sock = lwip_socket(AF_INET, SOCK_STREAM, 0);
+    lwip_setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (!httpd->tx
+            || lwip_bind(listen_sock, (struct sockaddr*)&addr, sizeof(addr))
+            || lwip_listen(listen_sock, HTTPD_MAX_CONNECTIONS)) {
+        printf("httpd: failed to start server\n");
+        lwip_close(listen_sock);
+        return;
+    }
+
+    while (true) {
+        struct timeval tv = {
+            .tv_sec = HTTPD_SELECT_TIMEOUT_MS / 1000,
+            .tv_usec = (HTTPD_SELECT_TIMEOUT_MS % 1000) * 1000,
+        };
+        int max_sock = listen_sock;
+        portTickType now;
+        fd_set fds;
+
+        // while a request body is received the other connections wait,
+        // they share the response buffer
+        FD_ZERO(&fds);
+        if (!httpd->body_conn) {
+            FD_SET(listen_sock, &fds);
+        }
+        for (int i = 0; i < HTTPD_MAX_CONNECTIONS; i++) {
+            int sock = httpd->conn[i].sock;
+            if (sock >= 0 && (!httpd->body_conn
+                        || httpd->body_conn == &httpd->conn[i])) {
+                FD_SET(sock, &fds);
+                if (sock > max_sock) {
+                    max_sock = sock;
+                }
+            }
+        }
+
+        if (lwip_select(max_sock + 1, &fds, NULL, NULL, &tv) > 0) {
+            for (int i = 0; i < HTTPD_MAX_CONNECTIONS; i++) {
+                HttpdConnection *conn = &httpd->conn[i];
+                if (conn->sock >= 0 && FD_ISSET(conn->sock, &fds)) {
+                    receive(httpd, conn);
+                }
+            }
+            if (FD_ISSET(listen_sock, &fds)) {
+                accept_connection(httpd, listen_sock);
+            }
+        }
+
+        now = xTaskGetTickCount();
+        for (int i = 0; i < HTTPD_MAX_CONNECTIONS; i++) {
+            HttpdConnection *conn = &httpd->conn[i];
+            if (conn->sock >= 0 && (now - conn->last_active)
+                    > HTTPD_IDLE_TIMEOUT_MS / portTICK_RATE_MS) {
+                close_connection(httpd, conn);
+            }
+        }
+    }
+}
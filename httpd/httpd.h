@@ -0,0 +1,117 @@
+/**
+ * The file implements a simple http server with persistent connections.
+ *
+ * Up to HTTPD_MAX_CONNECTIONS connections are served at once. Connections
+ * are kept open between requests (HTTP/1.1 keep-alive) until the client
+ * closes them, asks for "Connection: close" or stays idle for
+ * HTTPD_IDLE_TIMEOUT_MS. When all connections are busy a new one replaces
+ * the least recently used idle connection.
+ *
+ * A request is handled in the following steps:
+ *  - req_handler is called with the url and the method. The handler sets
+ *    the response status with httpd_send_header or httpd_send_status.
+ *  - For POST requests data_handler is called for each form field of the
+ *    body (multipart/form-data or application/x-www-form-urlencoded) as the
+ *    body is received and then data_complete_handler is called. A
+ *    multipart field larger than the receive buffer, e.g. a file, is
+ *    passed in several chunks with the same name, so the body size is not
+ *    limited. Other connections wait until the body is received.
+ *  - The response body is collected with httpd_send_data and is sent with
+ *    Content-Length when the request is handled. If the body doesn't fit
+ *    HTTPD_TX_BUFF_SIZE it is sent as it comes and the connection is closed
+ *    after the response.
+ *
+ * The request headers and urlencoded fields must fit HTTPD_RX_BUFF_SIZE.
+ */
+#ifndef __HTTPD_H__
+#define __HTTPD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+
+#define HTTPD_MAX_CONNECTIONS   3
+#define HTTPD_RX_BUFF_SIZE      1024
+#define HTTPD_TX_BUFF_SIZE      768
+#define HTTPD_IDLE_TIMEOUT_MS   10000
+#define HTTPD_BOUNDARY_SIZE     76
+#define HTTPD_FIELD_NAME_SIZE   32
+
+typedef enum {
+    HTTP_GET = 0,
+    HTTP_POST,
+    HTTP_UNKNOWN,
+} MethodType;
+
+typedef struct _Httpd Httpd;
+
+typedef void (*HttpdReqHandler)(Httpd *httpd, const char *url,
+        MethodType method);
+typedef void (*HttpdDataHandler)(Httpd *httpd, const char *name,
+        const void *data, uint16_t len);
+typedef void (*HttpdDataCompleteHandler)(Httpd *httpd, bool result);
+
+typedef struct {
+    int sock;           // -1 if not used
+    char *rx;
+    uint16_t rx_len;
+    portTickType last_active;
+} HttpdConnection;
+
+struct _Httpd {
+    HttpdReqHandler req_handler;
+    HttpdDataHandler data_handler;
+    HttpdDataCompleteHandler data_complete_handler;
+    void *user_data;
+
+    // private data
+    HttpdConnection conn[HTTPD_MAX_CONNECTIONS];
+    HttpdConnection *current;
+    char *tx;
+    uint16_t tx_len;
+    uint16_t status;
+    const char *content_type;
+    bool keep_alive;
+    bool streaming;
+
+    // request body being received
+    HttpdConnection *body_conn;
+    MethodType method;
+    int body_left;
+    uint8_t body_type;
+    uint8_t part_state;
+    bool body_result;
+    char delim[HTTPD_BOUNDARY_SIZE];    // "\r\n--" boundary
+    uint8_t delim_len;
+    char field[HTTPD_FIELD_NAME_SIZE];
+};
+
+/**
+ * Initialize private data of the server. Handlers must be set by the caller.
+ */
+void httpd_init(Httpd *httpd);
+
+/**
+ * Serve http requests on the given port.
+ * Returns only if the server fails to start.
+ */
+void httpd_serve(Httpd *httpd, uint16_t port);
+
+/**
+ * Set the response status to 200 OK if 'ok' is true, otherwise to
+ * 404 Not Found. Content type is text/html.
+ */
+void httpd_send_header(Httpd *httpd, bool ok);
+
+/**
+ * Set the response status code and content type.
+ */
+void httpd_send_status(Httpd *httpd, uint16_t status,
+        const char *content_type);
+
+/**
+ * Add data to the response body.
+ */
+void httpd_send_data(Httpd *httpd, const void *data, uint16_t len);
+
+#endif // __HTTPD_H__
@@ -0,0 +1,295 @@
+#include "sim.h"
+#include "task.h"
+#include "semphr.h"
+#include "midea-ir.h"
+#include "espressif/spi_flash.h"
+#include "espressif/esp_common.h"
+#include "rboot-api.h"
+
+#include <string.h>
+#include <setjmp.h>
+
+#define MAX_EVENTS  64
+#define MAX_TASKS   8
+#define MAX_SEMAPHORES 16
+
+typedef struct {
+    uint32_t time;
+    SimEvent event;
+    void *arg;
+} ScheduledEvent;
+
+typedef struct {
+    const char *name;
+    pdTASK_CODE code;
+    void *params;
+} SimTask;
+
+uint8_t sim_flash[SIM_FLASH_SIZE];
+sdk_flashchip_t sdk_flashchip = {
+    .chip_size = SIM_FLASH_SIZE,
+    .sector_size = SPI_FLASH_SEC_SIZE,
+};
+rboot_config sim_rboot_config;
+uint32_t sim_flash_erases = 0;
+uint32_t sim_ir_sends = 0;
+int sim_failures = 0;
+
+static uint32_t now = 0;
+static ScheduledEvent events[MAX_EVENTS];
+static int event_count = 0;
+static SimTask tasks[MAX_TASKS];
+static int task_count = 0;
+static SimSemaphore semaphores[MAX_SEMAPHORES];
+static int semaphore_count = 0;
+static jmp_buf idle;
+
+void sim_reset()
+{
+    now = 0;
+    event_count = 0;
+    task_count = 0;
+    semaphore_count = 0;
+    sim_flash_erases = 0;
+    sim_ir_sends = 0;
+    memset(sim_flash, 0xFF, SIM_FLASH_SIZE);
+}
+
+uint32_t sim_now()
+{
+    return now;
+}
+
+void sim_schedule(uint32_t delay, SimEvent event, void *arg)
+{
+    if (event_count == MAX_EVENTS) {
+        fprintf(stderr, "too many events\n");
+        exit(1);
+    }
+    events[event_count].time = now + delay;
+    events[event_count].event = event;
+    events[event_count].arg = arg;
+    event_count++;
+}
+
+/**
+ * Run the earliest event due not later than 'deadline'.
+ * Return false if there's no such event.
+ */
+static bool run_next(uint64_t deadline)
+{
+    int next = -1;
+
+    for (int i = 0; i < event_count; i++) {
+        if (next < 0 || events[i].time < events[next].time) {
+            next = i;
+        }
+    }
+    if (next < 0 || events[next].time > deadline) {
+        return false;
+    }
+
+    ScheduledEvent e = events[next];
+    events[next] = events[--event_count];
+    if (e.time > now) {
+        now = e.time;
+    }
+    e.event(e.arg);
+    return true;
+}
+
+void sim_run_task(const char *name)
+{
+    for (int i = 0; i < task_count; i++) {
+        if (!strcmp(tasks[i].name, name)) {
+            if (!setjmp(idle)) {
+                tasks[i].code(tasks[i].params);
+            }
+            return;
+        }
+    }
+    fprintf(stderr, "no task %s\n", name);
+    exit(1);
+}
+
+static xSemaphoreHandle create_semaphore(int count)
+{
+    if (semaphore_count == MAX_SEMAPHORES) {
+        fprintf(stderr, "too many semaphores\n");
+        exit(1);
+    }
+    semaphores[semaphore_count].count = count;
+    return &semaphores[semaphore_count++];
+}
+
+xSemaphoreHandle xSemaphoreCreateBinary()
+{
+    return create_semaphore(0);
+}
+
+xSemaphoreHandle xSemaphoreCreateMutex()
+{
+    return create_semaphore(1);
+}
+
+portBASE_TYPE xSemaphoreTake(xSemaphoreHandle sem, portTickType timeout)
+{
+    uint64_t deadline = timeout == portMAX_DELAY ?
+        UINT64_MAX : (uint64_t)now + timeout;
+
+    while (!sem->count) {
+        if (!run_next(deadline)) {
+            if (timeout == portMAX_DELAY) {
+                longjmp(idle, 1);   // blocked forever, simulation is over
+            }
+            now = deadline;
+            return pdFALSE;
+        }
+    }
+    sem->count = 0;
+    return pdTRUE;
+}
+
+portBASE_TYPE xSemaphoreGive(xSemaphoreHandle sem)
+{
+    sem->count = 1;
+    return pdTRUE;
+}
+
+portBASE_TYPE xTaskCreate(pdTASK_CODE code, const signed char *name,
+        uint16_t stack, void *params, int priority, xTaskHandle *handle)
+{
+    if (task_count == MAX_TASKS) {
+        fprintf(stderr, "too many tasks\n");
+        exit(1);
+    }
+    tasks[task_count].name = (const char*)name;
+    tasks[task_count].code = code;
+    tasks[task_count].params = params;
+    if (handle) {
+        *handle = &tasks[task_count];
+    }
+    task_count++;
+    return pdTRUE;
+}
+
+void vTaskDelete(xTaskHandle task)
+{
+    longjmp(idle, 1);
+}
+
+void vTaskDelay(portTickType ticks)
+{
+    uint64_t deadline = (uint64_t)now + ticks;
+
+    while (run_next(deadline)) {
+    }
+    now = deadline;
+}
+
+portTickType xTaskGetTickCount()
+{
+    return now;
+}
+
+xTaskHandle xTaskGetCurrentTaskHandle()
+{
+    return NULL;
+}
+
+unsigned uxTaskGetStackHighWaterMark(xTaskHandle task)
+{
+    return 0;
+}
+
+size_t xPortGetFreeHeapSize()
+{
+    return 0;
+}
+
+uint32_t sdk_system_get_time()
+{
+    return now * 1000;
+}
+
+void sdk_system_restart()
+{
+    longjmp(idle, 1);
+}
+
+sdk_SpiFlashOpResult sdk_spi_flash_erase_sector(uint16_t sec)
+{
+    if ((sec + 1) * SPI_FLASH_SEC_SIZE > SIM_FLASH_SIZE) {
+        return SPI_FLASH_RESULT_ERR;
+    }
+    memset(sim_flash + sec * SPI_FLASH_SEC_SIZE, 0xFF, SPI_FLASH_SEC_SIZE);
+    sim_flash_erases++;
+    return SPI_FLASH_RESULT_OK;
+}
+
+sdk_SpiFlashOpResult sdk_spi_flash_write(uint32_t des_addr, const void *src,
+        uint32_t size)
+{
+    if (des_addr % 4 || size % 4 || (uintptr_t)src % 4 ||
+            des_addr + size > SIM_FLASH_SIZE) {
+        return SPI_FLASH_RESULT_ERR;
+    }
+    // flash can only clear bits
+    for (uint32_t i = 0; i < size; i++) {
+        sim_flash[des_addr + i] &= ((const uint8_t*)src)[i];
+    }
+    return SPI_FLASH_RESULT_OK;
+}
+
+sdk_SpiFlashOpResult sdk_spi_flash_read(uint32_t src_addr, void *des,
+        uint32_t size)
+{
+    if (src_addr % 4 || size % 4 || (uintptr_t)des % 4 ||
+            src_addr + size > SIM_FLASH_SIZE) {
+        return SPI_FLASH_RESULT_ERR;
+    }
+    memcpy(des, sim_flash + src_addr, size);
+    return SPI_FLASH_RESULT_OK;
+}
+
+rboot_config rboot_get_config()
+{
+    return sim_rboot_config;
+}
+
+bool rboot_set_current_rom(uint8_t rom)
+{
+    if (rom >= sim_rboot_config.count) {
+        return false;
+    }
+    sim_rboot_config.current_rom = rom;
+    return true;
+}
+
+bool rboot_verify_image(uint32_t initial_offset, uint32_t *image_length,
+        const char **error_message)
+{
+    if (initial_offset >= SIM_FLASH_SIZE
+            || sim_flash[initial_offset] != 0xE9) {
+        *error_message = "bad image magic";
+        return false;
+    }
+    return true;
+}
+
+void midea_ir_init(MideaIR *ir, uint8_t gpio)
+{
+    ir->enabled = false;
+    ir->mode = MODE_AUTO;
+    ir->temperature = 24;
+    ir->fan_level = 0;
+}
+
+void midea_ir_send(MideaIR *ir)
+{
+    sim_ir_sends++;
+}
+
+void midea_ir_move_deflector(MideaIR *ir)
+{
+}
@@ -0,0 +1,54 @@
+/**
+ * Discrete event simulator for running firmware modules on the host.
+ *
+ * Events are scheduled at simulated times. Blocking RTOS calls (semaphore
+ * take, task delay) advance the simulated time and run the events that are
+ * due. When a task blocks forever and there are no more events, the
+ * simulation ends and sim_run_task returns.
+ */
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+
+#define SIM_FLASH_SIZE  0x400000
+
+typedef void (*SimEvent)(void *arg);
+
+extern uint8_t sim_flash[SIM_FLASH_SIZE];
+extern uint32_t sim_flash_erases;
+extern uint32_t sim_ir_sends;
+
+/**
+ * Reset time, events, tasks and erase the whole flash.
+ */
+void sim_reset();
+
+uint32_t sim_now();
+
+/**
+ * Schedule 'event' to run 'delay' ms from now.
+ */
+void sim_schedule(uint32_t delay, SimEvent event, void *arg);
+
+/**
+ * Run the task created by xTaskCreate with the given name until the
+ * simulation ends.
+ */
+void sim_run_task(const char *name);
+
+extern int sim_failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #cond); \
+        sim_failures++; \
+    } \
+} while (0)
+
+#endif // __SIM_H__
@@ -0,0 +1,47 @@
+/**
+ * Host stub of FreeRTOS for the simulator in sim.c.
+ *
+ * Time is simulated in ticks of 1 ms. Blocking calls run the scheduled
+ * simulator events until the call can return.
+ */
+#ifndef __FREERTOS_H__
+#define __FREERTOS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint32_t portTickType;
+typedef int portBASE_TYPE;
+
+#define portTICK_RATE_MS    1
+#define portMAX_DELAY       0xFFFFFFFF
+#define pdTRUE              1
+#define pdFALSE             0
+
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+typedef struct {
+    int count;
+} SimSemaphore;
+
+typedef SimSemaphore* xSemaphoreHandle;
+typedef void* xTaskHandle;
+typedef void (*pdTASK_CODE)(void *pvParams);
+
+xSemaphoreHandle xSemaphoreCreateBinary();
+xSemaphoreHandle xSemaphoreCreateMutex();
+portBASE_TYPE xSemaphoreTake(xSemaphoreHandle sem, portTickType timeout);
+portBASE_TYPE xSemaphoreGive(xSemaphoreHandle sem);
+
+portBASE_TYPE xTaskCreate(pdTASK_CODE code, const signed char *name,
+        uint16_t stack, void *params, int priority, xTaskHandle *handle);
+void vTaskDelete(xTaskHandle task);
+void vTaskDelay(portTickType ticks);
+portTickType xTaskGetTickCount();
+xTaskHandle xTaskGetCurrentTaskHandle();
+unsigned uxTaskGetStackHighWaterMark(xTaskHandle task);
+size_t xPortGetFreeHeapSize();
+
+#endif // __FREERTOS_H__
@@ -0,0 +1,15 @@
+/**
+ * Host stub of the hardware random number generator.
+ */
+#ifndef __HWRAND_H__
+#define __HWRAND_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static inline uint32_t hwrand()
+{
+    return ((uint32_t)rand() << 16) ^ rand();
+}
+
+#endif // __HWRAND_H__
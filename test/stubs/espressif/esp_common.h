@@ -0,0 +1,56 @@
+/**
+ * Host stub of the SDK common API.
+ */
+#ifndef __ESP_COMMON_H__
+#define __ESP_COMMON_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+uint32_t sdk_system_get_time();
+void sdk_system_restart();
+
+#define STATION_IF      0
+#define STATION_MODE    1
+
+enum {
+    STATION_IDLE = 0,
+    STATION_CONNECTING,
+    STATION_WRONG_PASSWORD,
+    STATION_NO_AP_FOUND,
+    STATION_CONNECT_FAIL,
+    STATION_GOT_IP,
+};
+
+struct sdk_station_config {
+    uint8_t ssid[32];
+    uint8_t password[64];
+    uint8_t bssid_set;
+    uint8_t bssid[6];
+};
+
+struct ip_addr {
+    uint32_t addr;
+};
+
+struct ip_info {
+    struct ip_addr ip;
+    struct ip_addr netmask;
+    struct ip_addr gw;
+};
+
+bool sdk_wifi_set_opmode(uint8_t opmode);
+bool sdk_wifi_station_set_config(struct sdk_station_config *config);
+bool sdk_wifi_station_get_config(struct sdk_station_config *config);
+bool sdk_wifi_station_connect();
+bool sdk_wifi_station_disconnect();
+uint8_t sdk_wifi_station_get_connect_status();
+bool sdk_wifi_station_dhcpc_start();
+bool sdk_wifi_station_dhcpc_stop();
+bool sdk_wifi_set_ip_info(uint8_t if_index, struct ip_info *info);
+bool sdk_wifi_get_ip_info(uint8_t if_index, struct ip_info *info);
+bool sdk_wifi_set_channel(uint8_t channel);
+uint8_t sdk_wifi_get_channel();
+bool sdk_wifi_get_macaddr(uint8_t if_index, uint8_t *macaddr);
+
+#endif // __ESP_COMMON_H__
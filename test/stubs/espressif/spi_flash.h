@@ -0,0 +1,34 @@
+/**
+ * Host stub of the SPI flash API, backed by the simulated flash in sim.c.
+ */
+#ifndef __SPI_FLASH_H__
+#define __SPI_FLASH_H__
+
+#include <stdint.h>
+
+#define SPI_FLASH_SEC_SIZE      4096
+
+typedef enum {
+    SPI_FLASH_RESULT_OK,
+    SPI_FLASH_RESULT_ERR,
+    SPI_FLASH_RESULT_TIMEOUT,
+} sdk_SpiFlashOpResult;
+
+typedef struct {
+    uint32_t device_id;
+    uint32_t chip_size;
+    uint32_t block_size;
+    uint32_t sector_size;
+    uint32_t page_size;
+    uint32_t status_mask;
+} sdk_flashchip_t;
+
+extern sdk_flashchip_t sdk_flashchip;
+
+sdk_SpiFlashOpResult sdk_spi_flash_erase_sector(uint16_t sec);
+sdk_SpiFlashOpResult sdk_spi_flash_write(uint32_t des_addr, const void *src,
+        uint32_t size);
+sdk_SpiFlashOpResult sdk_spi_flash_read(uint32_t src_addr, void *des,
+        uint32_t size);
+
+#endif // __SPI_FLASH_H__
@@ -0,0 +1,29 @@
+/**
+ * Host stub of lwIP sockets. The lwip_ functions map to POSIX sockets.
+ */
+#ifndef __LWIP_SOCKETS_H__
+#define __LWIP_SOCKETS_H__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define lwip_socket     socket
+#define lwip_bind       bind
+#define lwip_listen     listen
+#define lwip_accept     accept
+#define lwip_connect    connect
+#define lwip_setsockopt setsockopt
+#define lwip_select     select
+#define lwip_send       send
+#define lwip_recv       recv
+#define lwip_sendto     sendto
+#define lwip_recvfrom   recvfrom
+#define lwip_close      close
+
+#endif // __LWIP_SOCKETS_H__
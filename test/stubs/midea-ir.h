@@ -0,0 +1,30 @@
+/**
+ * Host stub of the midea-ir library.
+ * The mode values differ from their order on purpose, to catch code that
+ * relies on it.
+ */
+#ifndef __MIDEA_IR_H__
+#define __MIDEA_IR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    MODE_COOL = 0,
+    MODE_HEAT = 3,
+    MODE_AUTO = 2,
+    MODE_FAN = 1,
+} MideaMode;
+
+typedef struct {
+    bool enabled;
+    MideaMode mode;
+    uint8_t temperature;
+    uint8_t fan_level;
+} MideaIR;
+
+void midea_ir_init(MideaIR *ir, uint8_t gpio);
+void midea_ir_send(MideaIR *ir);
+void midea_ir_move_deflector(MideaIR *ir);
+
+#endif // __MIDEA_IR_H__
@@ -0,0 +1,31 @@
+/**
+ * Host stub of the rboot API. The configuration is sim_rboot_config in
+ * sim.c, an image is valid if it starts with the ESP image magic 0xE9.
+ */
+#ifndef __RBOOT_API_H__
+#define __RBOOT_API_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_ROMS    4
+
+typedef struct {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t mode;
+    uint8_t current_rom;
+    uint8_t gpio_rom;
+    uint8_t count;
+    uint8_t unused[2];
+    uint32_t roms[MAX_ROMS];
+} rboot_config;
+
+extern rboot_config sim_rboot_config;
+
+rboot_config rboot_get_config();
+bool rboot_set_current_rom(uint8_t rom);
+bool rboot_verify_image(uint32_t initial_offset, uint32_t *image_length,
+        const char **error_message);
+
+#endif // __RBOOT_API_H__
@@ -0,0 +1,43 @@
+/**
+ * Test that out of range values are rejected before the IR code is sent
+ * and the state is persisted.
+ */
+#include "sim.h"
+#include "ac_control.h"
+
+int main()
+{
+    MideaIR state;
+
+    sim_reset();
+    ac_control_init(14);
+
+    CHECK(ac_control_command("temp 25"));
+    CHECK(ac_control_command("fan_level 3"));
+    CHECK(ac_control_command("cool"));
+    CHECK(sim_ir_sends == 3);
+
+    CHECK(!ac_control_command("temp 99"));
+    CHECK(!ac_control_command("temp 16"));
+    CHECK(!ac_control_command("temp abc"));
+    CHECK(!ac_control_command("fan_level 4"));
+    CHECK(!ac_control_execute(AC_CMD_FAN_LEVEL, -1));
+    CHECK(!ac_control_execute(AC_CMD_TEMP, 255));
+    CHECK(!ac_control_execute(AC_CMD_MODE, 7));
+    CHECK(!ac_control_execute(AC_CMD_SIZE, 0));
+
+    ac_control_get(&state);
+    state.temperature = 31;
+    CHECK(!ac_control_set(&state));
+    state.temperature = 30;
+    state.fan_level = 4;
+    CHECK(!ac_control_set(&state));
+    CHECK(sim_ir_sends == 3);
+
+    ac_control_get(&state);
+    CHECK(state.temperature == 25 && state.fan_level == 3 &&
+            state.mode == MODE_COOL);
+    CHECK(ac_control_state_valid(&state));
+
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,415 @@
+/**
+ * Test the http server and the REST API over real sockets on localhost and
+ * measure requests per second with and without keep-alive.
+ *
+ * The server runs in its own thread, the test is the client.
+ */
+#include "sim.h"
+#include "httpd.h"
+#include "http_api.h"
+#include "ac_control.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define BENCH_REQUESTS  2000
+#define RESPONSE_SIZE   2048
+#define URLENCODED      "application/x-www-form-urlencoded"
+#define UPLOAD_SIZE     (64 * 1024)
+#define UPLOAD          ((void*)2)
+
+static uint16_t port;
+
+// bytes of the "firmware" field received by the upload handler
+static uint32_t upload_len;
+static uint32_t upload_sum;
+static int upload_chunks;
+
+static void req_handler(Httpd *httpd, const char *url, MethodType method)
+{
+    httpd->user_data = 0;
+    if (method == HTTP_POST && !strcmp(url, "/upload")) {
+        httpd->user_data = UPLOAD;
+        upload_len = upload_sum = upload_chunks = 0;
+        httpd_send_header(httpd, true);
+        return;
+    }
+    if (method == HTTP_GET && http_api_get(httpd, url)) {
+        return;
+    }
+    if (method == HTTP_POST && http_api_post(httpd, url)) {
+        return;
+    }
+    httpd_send_header(httpd, false);
+}
+
+static void data_handler(Httpd *httpd, const char *name, const void *data,
+        uint16_t len)
+{
+    if (httpd->user_data == UPLOAD) {
+        if (!strcmp(name, "firmware")) {
+            for (int i = 0; i < len; i++) {
+                upload_sum += ((const uint8_t*)data)[i];
+            }
+            upload_len += len;
+            upload_chunks++;
+        }
+        return;
+    }
+    http_api_data(httpd, name, data, len);
+}
+
+static void data_complete_handler(Httpd *httpd, bool result)
+{
+    if (httpd->user_data == UPLOAD) {
+        char reply[64];
+
+        snprintf(reply, sizeof(reply), "%s %u %u", result ? "ok" : "fail",
+                upload_len, upload_sum);
+        httpd_send_data(httpd, reply, strlen(reply));
+        return;
+    }
+    http_api_complete(httpd, result);
+}
+
+static void *server_thread(void *arg)
+{
+    Httpd httpd;
+
+    httpd.req_handler = req_handler;
+    httpd.data_handler = data_handler;
+    httpd.data_complete_handler = data_complete_handler;
+    httpd_init(&httpd);
+    httpd_serve(&httpd, port);
+    fprintf(stderr, "server failed to start\n");
+    exit(1);
+    return NULL;
+}
+
+static int connect_server()
+{
+    struct sockaddr_in addr;
+    int opt = 1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    for (int i = 0; i < 100; i++) {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (!connect(sock, (struct sockaddr*)&addr, sizeof(addr))) {
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+            return sock;
+        }
+        close(sock);
+        usleep(10000);
+    }
+    fprintf(stderr, "failed to connect\n");
+    exit(1);
+}
+
+static void send_str(int sock, const char *str)
+{
+    send(sock, str, strlen(str), 0);
+}
+
+/**
+ * Read one response. The body length is taken from Content-Length, or
+ * the response is read until the connection is closed.
+ * Returns the status code, or 0 if the connection is closed.
+ */
+static int read_response(int sock, char *headers, char *body)
+{
+    static char buff[RESPONSE_SIZE];
+    static int buff_len;
+    static int buff_sock = -1;
+    const char *value;
+    char *end = NULL;
+    int header_len, body_len = -1;
+
+    if (sock != buff_sock) {
+        buff_len = 0;
+        buff_sock = sock;
+    }
+
+    while (true) {
+        int len;
+
+        buff[buff_len] = 0;
+        end = strstr(buff, "\r\n\r\n");
+        if (end) {
+            header_len = end - buff + 4;
+            value = strstr(buff, "Content-Length: ");
+            if (value && value < end) {
+                body_len = atoi(value + strlen("Content-Length: "));
+                if (buff_len >= header_len + body_len) {
+                    break;
+                }
+            }
+        }
+        len = recv(sock, buff + buff_len, RESPONSE_SIZE - 1 - buff_len, 0);
+        if (len <= 0) {
+            if (!end) {
+                return 0;
+            }
+            body_len = buff_len - header_len;
+            break;
+        }
+        buff_len += len;
+    }
+
+    memcpy(headers, buff, header_len);
+    headers[header_len] = 0;
+    memcpy(body, buff + header_len, body_len);
+    body[body_len] = 0;
+    buff_len -= header_len + body_len;
+    memmove(buff, buff + header_len + body_len, buff_len);
+    return atoi(headers + strlen("HTTP/1.1 "));
+}
+
+static int request(int sock, const char *req, char *headers, char *body)
+{
+    send_str(sock, req);
+    return read_response(sock, headers, body);
+}
+
+static void post_form(const char *content_type, const char *form, char *req)
+{
+    sprintf(req, "POST /api/state HTTP/1.1\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %d\r\n\r\n%s", content_type,
+            (int)strlen(form), form);
+}
+
+static bool closed(int sock)
+{
+    char c;
+    // reset if the server closed with unread data
+    return recv(sock, &c, 1, 0) <= 0;
+}
+
+static const char get_state[] = "GET /api/state HTTP/1.1\r\n"
+    "Host: localhost\r\n\r\n";
+
+static void test_keep_alive()
+{
+    char headers[RESPONSE_SIZE], body[RESPONSE_SIZE];
+    int sock = connect_server();
+
+    CHECK(request(sock, get_state, headers, body) == 200);
+    CHECK(strstr(headers, "Content-Type: application/json\r\n"));
+    CHECK(strstr(headers, "Connection: keep-alive\r\n"));
+    CHECK(!strcmp(body, "{\"enabled\":false,\"mode\":\"auto\","
+                "\"temperature\":24,\"fan_level\":0}"));
+
+    // second request on the same connection
+    CHECK(request(sock, "GET /api/metrics HTTP/1.1\r\n\r\n",
+                headers, body) == 200);
+    CHECK(strstr(headers, "Content-Type: application/json\r\n"));
+    CHECK(body[0] == '{');
+
+    // pipelined requests
+    send_str(sock, "GET /api/state HTTP/1.1\r\n\r\n"
+            "GET /nothing HTTP/1.1\r\n\r\n");
+    CHECK(read_response(sock, headers, body) == 200);
+    CHECK(read_response(sock, headers, body) == 404);
+    CHECK(strstr(headers, "Content-Length: 0\r\n"));
+
+    // explicit close
+    CHECK(request(sock, "GET /api/state HTTP/1.1\r\n"
+                "Connection: close\r\n\r\n", headers, body) == 200);
+    CHECK(strstr(headers, "Connection: close\r\n"));
+    CHECK(closed(sock));
+    close(sock);
+
+    // the headers must fit the receive buffer
+    sock = connect_server();
+    memset(body, 'a', HTTPD_RX_BUFF_SIZE);
+    body[HTTPD_RX_BUFF_SIZE] = 0;
+    send_str(sock, "GET /api/state HTTP/1.1\r\nX-Large: ");
+    CHECK(request(sock, body, headers, body) == 413);
+    CHECK(closed(sock));
+    close(sock);
+
+    // HTTP/1.0 closes by default
+    sock = connect_server();
+    CHECK(request(sock, "GET /api/state HTTP/1.0\r\n\r\n",
+                headers, body) == 200);
+    CHECK(strstr(headers, "Connection: close\r\n"));
+    CHECK(closed(sock));
+    close(sock);
+}
+
+static void test_post()
+{
+    char headers[RESPONSE_SIZE], body[RESPONSE_SIZE], req[RESPONSE_SIZE];
+    int sock = connect_server();
+
+    post_form(URLENCODED, "enabled=on&mode=cool&temperature=22&fan_level=2",
+            req);
+    CHECK(request(sock, req, headers, body) == 200);
+    CHECK(strstr(headers, "Content-Type: application/json\r\n"));
+    CHECK(!strcmp(body, "{\"enabled\":true,\"mode\":\"cool\","
+                "\"temperature\":22,\"fan_level\":2}"));
+
+    post_form(URLENCODED, "enabled=maybe", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    CHECK(strstr(headers, "Content-Type: application/json\r\n"));
+    CHECK(!strcmp(body, "{\"error\":\"invalid state\"}"));
+
+    post_form(URLENCODED, "temperature=40", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    post_form(URLENCODED, "fan_level=4", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    // values that wrap around in uint8_t or are not numbers
+    post_form(URLENCODED, "temperature=280", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    post_form(URLENCODED, "temperature=-232", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    post_form(URLENCODED, "fan_level=257", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    post_form(URLENCODED, "temperature=24abc", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    post_form(URLENCODED, "temperature=", req);
+    CHECK(request(sock, req, headers, body) == 400);
+    post_form(URLENCODED, "mode=dry", req);
+    CHECK(request(sock, req, headers, body) == 400);
+
+    // multipart form, as sent by the config page
+    post_form("multipart/form-data; boundary=xyz",
+            "--xyz\r\n"
+            "Content-Disposition: form-data; name=\"enabled\"\r\n\r\n"
+            "off\r\n"
+            "--xyz\r\n"
+            "Content-Disposition: form-data; name=\"temperature\"\r\n\r\n"
+            "27\r\n"
+            "--xyz--\r\n", req);
+    CHECK(request(sock, req, headers, body) == 200);
+    CHECK(!strcmp(body, "{\"enabled\":false,\"mode\":\"cool\","
+                "\"temperature\":27,\"fan_level\":2}"));
+
+    // the rejected requests did not change the state
+    CHECK(request(sock, get_state, headers, body) == 200);
+    CHECK(strstr(body, "\"temperature\":27"));
+    CHECK(sim_ir_sends == 2);
+    close(sock);
+}
+
+/**
+ * Upload a file larger than the receive buffer in small pieces, as the
+ * firmware form of the config page does. The content has parts of the
+ * delimiter in it.
+ */
+static void test_upload()
+{
+    static const char head[] = "--xyz\r\n"
+        "Content-Disposition: form-data; name=\"firmware\"; "
+        "filename=\"fw.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n\r\n";
+    static const char tail[] = "\r\n--xyz\r\n"
+        "Content-Disposition: form-data; name=\"note\"\r\n\r\n"
+        "x\r\n--xyz--\r\n";
+    static uint8_t file[UPLOAD_SIZE];
+    char headers[RESPONSE_SIZE], body[RESPONSE_SIZE], expected[64];
+    uint32_t sum = 0;
+    int sock = connect_server();
+
+    for (int i = 0; i < UPLOAD_SIZE; i++) {
+        file[i] = i % 97 == 0 ? '\r' : i % 97 == 1 ? '\n' :
+            i % 97 < 5 ? '-' : rand();
+        sum += file[i];
+    }
+
+    sprintf(body, "POST /upload HTTP/1.1\r\n"
+            "Content-Type: multipart/form-data; boundary=xyz\r\n"
+            "Content-Length: %d\r\n\r\n%s",
+            (int)(strlen(head) + UPLOAD_SIZE + strlen(tail)), head);
+    send_str(sock, body);
+    for (int i = 0; i < UPLOAD_SIZE; i += 1000) {
+        send(sock, file + i, UPLOAD_SIZE - i < 1000 ? UPLOAD_SIZE - i : 1000,
+                0);
+        usleep(100);
+    }
+    CHECK(request(sock, tail, headers, body) == 200);
+    snprintf(expected, sizeof(expected), "ok %u %u", UPLOAD_SIZE, sum);
+    CHECK(!strcmp(body, expected));
+    CHECK(upload_chunks > 1);
+
+    // the connection is kept after the upload
+    CHECK(request(sock, get_state, headers, body) == 200);
+
+    // multipart body without the closing delimiter
+    sprintf(body, "POST /upload HTTP/1.1\r\n"
+            "Content-Type: multipart/form-data; boundary=xyz\r\n"
+            "Content-Length: %d\r\n\r\n%sabc",
+            (int)strlen(head) + 3, head);
+    CHECK(request(sock, body, headers, body) == 200);
+    CHECK(!strncmp(body, "fail", 4));
+    close(sock);
+}
+
+static double elapsed(struct timespec *start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec)
+        + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void bench(bool keep_alive)
+{
+    static const char get_state_close[] = "GET /api/state HTTP/1.1\r\n"
+        "Connection: close\r\n\r\n";
+    char headers[RESPONSE_SIZE], body[RESPONSE_SIZE];
+    struct timespec start;
+    int sock = -1;
+    int ok = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        if (sock < 0) {
+            sock = connect_server();
+        }
+        if (request(sock, keep_alive ? get_state : get_state_close,
+                    headers, body) == 200) {
+            ok++;
+        }
+        if (!keep_alive) {
+            close(sock);
+            sock = -1;
+        }
+    }
+    if (sock >= 0) {
+        close(sock);
+    }
+    CHECK(ok == BENCH_REQUESTS);
+    printf("## %s: %.0f requests/s\n", keep_alive ? "keep-alive" : "close",
+            BENCH_REQUESTS / elapsed(&start));
+}
+
+int main()
+{
+    pthread_t server;
+
+    sim_reset();
+    ac_control_init(14);
+
+    port = 20000 + getpid() % 10000;
+    pthread_create(&server, NULL, server_thread, NULL);
+
+    test_keep_alive();
+    test_post();
+    test_upload();
+    bench(false);
+    bench(true);
+
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * Round trip of packed OTA images. Images packed by tools/ota_pack.py are
+ * sent to the OTA server over a localhost socket and unpacked into the
+ * simulated flash, which must then hold the original image byte by byte.
+ *
+ * The OTA task runs in its own thread, the test is the client.
+ */
+#include "sim.h"
+#include "ota_packed.h"
+#include "rboot-api.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define SLOT0           0x2000
+#define SLOT1           0x102000    // above the config area, 4 MB flash
+#define IMAGE_SIZE      (128 * 1024)
+#define PACKED_SIZE     (2 * IMAGE_SIZE)
+
+#define BASE_FILE       "ota_base.bin"
+#define IMAGE_FILE      "ota_image.bin"
+#define PACKED_FILE     "ota_image.gzp"
+
+static uint8_t base[IMAGE_SIZE];
+static uint8_t image[IMAGE_SIZE];
+static uint8_t packed[PACKED_SIZE];
+static uint16_t port;
+
+/**
+ * Something that looks like firmware: instructions made of a few opcodes
+ * with random operands, a string table and padding.
+ */
+static void make_image(uint8_t *buff, uint32_t size)
+{
+    static const uint8_t opcodes[] = {0x12, 0xc1, 0xf0, 0x0d, 0xf0, 0x22,
+        0xa0, 0x00, 0x82, 0x61, 0x00, 0x06};
+    static const char *strings[] = {"wifi connected", "mqtt connect error",
+        "OTA: receiving image", "state restored", "/api/state"};
+    uint32_t pos = 0;
+
+    buff[pos++] = 0xE9;     // ESP image magic
+    while (pos < size) {
+        uint32_t kind = rand() % 16;
+        if (kind < 12) {
+            buff[pos++] = opcodes[(rand() % 4) * 3];
+            if (pos < size) {
+                buff[pos++] = rand();
+            }
+            if (pos < size) {
+                buff[pos++] = rand() % 4;
+            }
+        } else if (kind < 15) {
+            const char *s = strings[rand() % 5];
+            for (int i = 0; s[i] && pos < size; i++) {
+                buff[pos++] = s[i];
+            }
+        } else {
+            for (int i = rand() % 64; i && pos < size; i--) {
+                buff[pos++] = 0;
+            }
+        }
+    }
+}
+
+/**
+ * New version of the base image: a few changed bytes and an inserted
+ * function that shifts the rest of the image.
+ */
+static void make_update(uint8_t *buff, const uint8_t *from, uint32_t size)
+{
+    const uint32_t insert_pos = size / 3, insert_len = 300;
+
+    memcpy(buff, from, insert_pos);
+    make_image(buff + insert_pos, insert_len);
+    buff[insert_pos] = from[insert_pos];
+    memcpy(buff + insert_pos + insert_len, from + insert_pos,
+            size - insert_pos - insert_len);
+    for (int i = 0; i < 20; i++) {
+        buff[1 + rand() % (size - 1)] ^= 0x10;
+    }
+}
+
+static void write_file(const char *name, const uint8_t *data, uint32_t size)
+{
+    FILE *f = fopen(name, "wb");
+    CHECK(f && fwrite(data, 1, size, f) == size);
+    fclose(f);
+}
+
+static uint32_t pack(bool delta)
+{
+    char cmd[256];
+    uint32_t size;
+    FILE *f;
+
+    write_file(IMAGE_FILE, image, IMAGE_SIZE);
+    snprintf(cmd, sizeof(cmd), "python3 ../tools/ota_pack.py pack "
+            IMAGE_FILE " -o " PACKED_FILE " %s > /dev/null",
+            delta ? "--base " BASE_FILE : "");
+    if (delta) {
+        write_file(BASE_FILE, base, IMAGE_SIZE);
+    }
+    if (system(cmd)) {
+        fprintf(stderr, "ota_pack.py failed\n");
+        exit(1);
+    }
+
+    f = fopen(PACKED_FILE, "rb");
+    CHECK(f);
+    size = fread(packed, 1, PACKED_SIZE, f);
+    fclose(f);
+    return size;
+}
+
+static void *ota_thread(void *arg)
+{
+    sim_run_task("ota");
+    return NULL;
+}
+
+static pthread_t start_server()
+{
+    pthread_t thread;
+
+    sim_reset();
+    memset(&sim_rboot_config, 0, sizeof(sim_rboot_config));
+    sim_rboot_config.count = 2;
+    sim_rboot_config.roms[0] = SLOT0;
+    sim_rboot_config.roms[1] = SLOT1;
+    memcpy(sim_flash + SLOT0, base, IMAGE_SIZE);
+
+    port++;
+    ota_packed_init_server(port);
+    pthread_create(&thread, NULL, ota_thread, NULL);
+    return thread;
+}
+
+/**
+ * Send 'len' bytes of the packed image and return the first reply line.
+ */
+static void send_image(uint32_t len, char *reply, int size)
+{
+    struct sockaddr_in addr;
+    int sock = -1;
+    int pos = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    for (int i = 0; i < 100; i++) {
+        sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (!connect(sock, (struct sockaddr*)&addr, sizeof(addr))) {
+            break;
+        }
+        close(sock);
+        sock = -1;
+        usleep(10000);
+    }
+    if (sock < 0) {
+        fprintf(stderr, "failed to connect\n");
+        exit(1);
+    }
+
+    CHECK(send(sock, packed, len, 0) == len);
+    shutdown(sock, SHUT_WR);
+    while (pos < size - 1) {
+        int n = recv(sock, reply + pos, size - 1 - pos, 0);
+        if (n <= 0) {
+            break;
+        }
+        pos += n;
+    }
+    reply[pos] = 0;
+    close(sock);
+}
+
+static void test_round_trip(const char *name, bool delta)
+{
+    char reply[64];
+    uint32_t len = pack(delta);
+    pthread_t thread = start_server();
+
+    send_image(len, reply, sizeof(reply));
+    pthread_join(thread, NULL);     // the task restarts after an update
+
+    CHECK(!strcmp(reply, "OK\n"));
+    CHECK(!memcmp(sim_flash + SLOT1, image, IMAGE_SIZE));
+    CHECK(sim_rboot_config.current_rom == 1);
+    printf("## %-12s %6d -> %6d bytes, %.1f%% reduction\n", name,
+            IMAGE_SIZE, len, 100.0 * (IMAGE_SIZE - len) / IMAGE_SIZE);
+}
+
+static void test_errors()
+{
+    char reply[64];
+    uint32_t len = pack(false);
+
+    start_server();
+
+    send_image(len / 2, reply, sizeof(reply));
+    CHECK(!strcmp(reply, "ERR connection closed\n"));
+
+    packed[12] ^= 1;    // image crc
+    send_image(len, reply, sizeof(reply));
+    CHECK(!strcmp(reply, "ERR image crc mismatch\n"));
+    packed[12] ^= 1;
+
+    packed[5] = 31;     // window bits
+    send_image(len, reply, sizeof(reply));
+    CHECK(!strcmp(reply, "ERR window is too big\n"));
+
+    CHECK(sim_rboot_config.current_rom == 0);
+}
+
+int main()
+{
+    srand(1);
+    port = 30000 + getpid() % 10000;
+
+    make_image(base, IMAGE_SIZE);
+    memcpy(image, base, IMAGE_SIZE);
+    make_update(image, base, IMAGE_SIZE);
+
+    test_round_trip("compressed", false);
+    test_round_trip("delta", true);
+    test_errors();
+
+    unlink(BASE_FILE);
+    unlink(IMAGE_FILE);
+    unlink(PACKED_FILE);
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * Measure flash writes of the state store per 1000 commands and check that
+ * the state survives power loss during a write or an erase.
+ */
+#include "sim.h"
+#include "state_store.h"
+#include "esp_config.h"
+#include "espressif/spi_flash.h"
+
+#include <string.h>
+
+#define SECTOR_ENTRIES  (SPI_FLASH_SEC_SIZE / STATE_STORE_ENTRY_SIZE)
+#define JOURNAL_ENTRIES (CONFIG_STATE_SIZE / STATE_STORE_ENTRY_SIZE)
+
+#define COMMANDS 1000
+
+typedef struct {
+    const char *name;
+    uint32_t interval_ms;   // time between commands, 0 - random 0-20 s
+    bool same_value;        // every command sets the same state
+    uint32_t max_writes;
+} Scenario;
+
+static MideaIR ir;
+static int sent;
+static const Scenario *scenario;
+
+static void command_event(void *arg)
+{
+    if (scenario->same_value) {
+        ir.temperature = 26;
+    } else if (scenario->interval_ms) {
+        ir.temperature = 24 + sent % 2;
+    } else {
+        ir.temperature = 17 + rand() % 14;
+    }
+    state_store_update(&ir);
+
+    if (++sent < COMMANDS) {
+        uint32_t interval = scenario->interval_ms ?
+            scenario->interval_ms : (uint32_t)(rand() % 20000);
+        sim_schedule(interval, command_event, NULL);
+    }
+}
+
+static void run(const Scenario *s)
+{
+    scenario = s;
+    sent = 0;
+    srand(1);
+    sim_reset();
+
+    midea_ir_init(&ir, 14);
+    state_store_init(&ir);
+    if (s->same_value) {
+        // the device already runs with this state
+        ir.temperature = 26;
+        state_store_update(&ir);
+        sim_run_task("state");
+    }
+
+    uint32_t writes = state_store_get_write_count();
+    uint32_t erases = sim_flash_erases;
+    uint32_t start = sim_now();
+
+    sim_schedule(0, command_event, NULL);
+    sim_run_task("state");
+
+    writes = state_store_get_write_count() - writes;
+    printf("## %-28s %6u s %8u writes %8u erases\n", s->name,
+            (sim_now() - start) / 1000, writes, sim_flash_erases - erases);
+    CHECK(writes <= s->max_writes);
+    // a sector is erased once per SECTOR_ENTRIES writes
+    CHECK(sim_flash_erases - erases <= writes / SECTOR_ENTRIES + 1);
+
+    // the last state must be restored after reboot
+    MideaIR restored;
+    midea_ir_init(&restored, 14);
+    state_store_init(&restored);
+    CHECK(restored.temperature == ir.temperature);
+}
+
+static const Scenario scenarios[] = {
+    // 200 s of commands, one write per STATE_STORE_MAX_DELAY_MS
+    {"burst, 200 ms apart", 200, false,
+        COMMANDS * 200 / STATE_STORE_MAX_DELAY_MS + 1},
+    // every change settles before the next one, so every one is written
+    {"spaced, 10 s apart", 10000, false, COMMANDS},
+    {"same state, 1 s apart", 1000, true, 0},
+    {"random state, 0-20 s apart", 0, false, COMMANDS},
+};
+
+static void save(uint8_t temperature)
+{
+    ir.temperature = temperature;
+    state_store_update(&ir);
+    sim_run_task("state");
+}
+
+static uint8_t restore()
+{
+    MideaIR restored;
+
+    midea_ir_init(&restored, 14);
+    state_store_init(&restored);
+    return restored.temperature;
+}
+
+static void test_power_loss()
+{
+    uint32_t addr;
+
+    sim_reset();
+    midea_ir_init(&ir, 14);
+    state_store_init(&ir);
+
+    // fill the whole journal, the next write erases the first sector
+    for (int i = 0; i < JOURNAL_ENTRIES; i++) {
+        save(17 + i % 13);
+    }
+    CHECK(sim_flash_erases == JOURNAL_ENTRIES / SECTOR_ENTRIES);
+    CHECK(restore() == 17 + (JOURNAL_ENTRIES - 1) % 13);
+
+    // power loss right after the erase, the other sector has the state
+    sdk_spi_flash_erase_sector(CONFIG_STATE_ADDR / SPI_FLASH_SEC_SIZE);
+    CHECK(restore() == 17 + (JOURNAL_ENTRIES - 1) % 13);
+    save(30);
+    CHECK(restore() == 30);
+
+    // power loss during a write leaves a partially programmed entry
+    addr = CONFIG_STATE_ADDR + STATE_STORE_ENTRY_SIZE;
+    sim_flash[addr] = 0x00;
+    sim_flash[addr + 4] = 0x12;
+    CHECK(restore() == 30);
+    save(29);
+    CHECK(restore() == 29);
+    printf("## power loss during erase and write: state restored\n");
+}
+
+int main()
+{
+    printf("## Flash writes per %d commands (delay %d ms, max delay %d ms)\n",
+            COMMANDS, STATE_STORE_DELAY_MS, STATE_STORE_MAX_DELAY_MS);
+    for (int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        run(&scenarios[i]);
+    }
+    test_power_loss();
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Test replay protection of the UDP control protocol. The server task runs
+ * in its own thread on UDP_CTRL_PORT, the test is the client.
+ */
+#include "sim.h"
+#include "udp_ctrl.h"
+#include "ac_control.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static int sock;
+static struct sockaddr_in addr;
+static uint32_t session;
+
+const char* config_get_name()
+{
+    return "name_0";
+}
+
+const char* config_get_location()
+{
+    return "room_0";
+}
+
+static void *udp_thread(void *arg)
+{
+    sim_run_task("udp");
+    return NULL;
+}
+
+static UdpStatus request(uint8_t type, uint32_t seq, uint8_t cmd,
+        uint8_t value)
+{
+    uint8_t buff[64];
+    UdpHeader *header = (UdpHeader*)buff;
+    UdpCommand *command = (UdpCommand*)(buff + sizeof(UdpHeader));
+    UdpStatus status;
+
+    header->magic[0] = 'G';
+    header->magic[1] = 'Z';
+    header->version = UDP_CTRL_VERSION;
+    header->type = type;
+    header->session = session;
+    header->seq = seq;
+    command->cmd = cmd;
+    command->value = value;
+
+    sendto(sock, buff, sizeof(UdpHeader) + sizeof(UdpCommand), 0,
+            (struct sockaddr*)&addr, sizeof(addr));
+    memset(&status, 0xFF, sizeof(status));
+    if (recv(sock, buff, sizeof(buff), 0) >=
+            (int)(sizeof(UdpHeader) + sizeof(UdpStatus))) {
+        session = header->session;
+        memcpy(&status, buff + sizeof(UdpHeader), sizeof(status));
+    }
+    return status;
+}
+
+static uint8_t command(uint32_t seq, uint8_t temperature)
+{
+    return request(UDP_COMMAND, seq, AC_CMD_TEMP, temperature).result;
+}
+
+int main()
+{
+    struct timeval tv = {1, 0};
+    pthread_t thread;
+
+    sim_reset();
+    ac_control_init(14);
+    udp_ctrl_init();
+    pthread_create(&thread, NULL, udp_thread, NULL);
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(UDP_CTRL_PORT);
+
+    // the server may not be ready for the first packet
+    for (int i = 0; i < 10 && request(UDP_GET_STATUS, 0, 0, 0).result; i++) {
+    }
+
+    CHECK(command(1, 20) == UDP_RESULT_OK);
+    CHECK(command(1, 21) == UDP_RESULT_REPLAY);
+    CHECK(command(0, 21) == UDP_RESULT_REPLAY);
+    CHECK(command(3, 21) == UDP_RESULT_OK);
+
+    // a seq too far ahead is rejected and doesn't lock out the others
+    CHECK(command(0x7FFFFFFF, 22) == UDP_RESULT_BAD_SEQ);
+    CHECK(command(3 + UDP_CTRL_MAX_SEQ_STEP + 1, 22) == UDP_RESULT_BAD_SEQ);
+    CHECK(command(0xFFFFFFFF, 22) == UDP_RESULT_REPLAY);
+    CHECK(command(4, 22) == UDP_RESULT_OK);
+    CHECK(command(4 + UDP_CTRL_MAX_SEQ_STEP, 23) == UDP_RESULT_OK);
+    CHECK(request(UDP_GET_STATUS, 0, 0, 0).last_seq
+            == 4 + UDP_CTRL_MAX_SEQ_STEP);
+    CHECK(request(UDP_GET_STATUS, 0, 0, 0).temperature == 23);
+
+    // wrong session
+    session++;
+    CHECK(command(3, 26) == UDP_RESULT_BAD_SESSION);
+
+    return sim_failures ? 1 : 0;
+}
@@ -0,0 +1,291 @@
+/**
+ * Test WiFi connection state machine against a simulated WiFi driver.
+ */
+#include "sim.h"
+#include "wifi_conn.h"
+#include "esp_config.h"
+#include "espressif/esp_common.h"
+
+#include <string.h>
+
+#define SCAN_MS     2000    // association with a full scan
+#define DIRECT_MS   200     // association to a known BSSID and channel
+#define DHCP_MS     600
+#define IP(a, b, c, d)  ((a) | (b) << 8 | (c) << 16 | (uint32_t)(d) << 24)
+
+/**
+ * Simulated WiFi driver and access point.
+ */
+static struct {
+    // access point
+    uint8_t ap_bssid[6];
+    uint8_t ap_channel;
+    uint32_t lease_ip;      // address the DHCP server gives out
+
+    // station
+    struct sdk_station_config config;
+    uint8_t channel;
+    uint8_t status;
+    bool dhcp;
+    struct ip_info ip;
+    uint32_t attempt;       // invalidates events of older attempts
+    int dhcp_starts;
+} wifi;
+
+static void dhcp_bound(void *arg)
+{
+    if ((uintptr_t)arg != wifi.attempt || !wifi.dhcp) {
+        return;
+    }
+    wifi.ip.ip.addr = wifi.lease_ip;
+    wifi.ip.netmask.addr = IP(255, 255, 255, 0);
+    wifi.ip.gw.addr = IP(192, 168, 0, 1);
+    wifi.status = STATION_GOT_IP;
+}
+
+static void associated(void *arg)
+{
+    if ((uintptr_t)arg != wifi.attempt) {
+        return;
+    }
+    wifi.channel = wifi.ap_channel;
+    memcpy(wifi.config.bssid, wifi.ap_bssid, 6);
+    if (wifi.dhcp) {
+        sim_schedule(DHCP_MS, dhcp_bound, arg);
+    } else {
+        wifi.status = STATION_GOT_IP;
+    }
+}
+
+static void link_lost(void *arg)
+{
+    wifi.status = STATION_CONNECTING;
+    wifi.attempt++;
+    // the SDK reconnects by itself
+    sim_schedule(SCAN_MS, associated, (void*)(uintptr_t)wifi.attempt);
+}
+
+bool sdk_wifi_set_opmode(uint8_t opmode)
+{
+    return true;
+}
+
+bool sdk_wifi_station_set_config(struct sdk_station_config *config)
+{
+    wifi.config = *config;
+    return true;
+}
+
+bool sdk_wifi_station_get_config(struct sdk_station_config *config)
+{
+    *config = wifi.config;
+    return true;
+}
+
+bool sdk_wifi_station_connect()
+{
+    wifi.attempt++;
+    wifi.status = STATION_CONNECTING;
+    if (!wifi.config.bssid_set) {
+        sim_schedule(SCAN_MS, associated, (void*)(uintptr_t)wifi.attempt);
+    } else if (!memcmp(wifi.config.bssid, wifi.ap_bssid, 6)) {
+        sim_schedule(wifi.channel == wifi.ap_channel ? DIRECT_MS : SCAN_MS,
+                associated, (void*)(uintptr_t)wifi.attempt);
+    }
+    // otherwise the cached AP is gone and the station never connects
+    return true;
+}
+
+bool sdk_wifi_station_disconnect()
+{
+    wifi.attempt++;
+    wifi.status = STATION_IDLE;
+    return true;
+}
+
+uint8_t sdk_wifi_station_get_connect_status()
+{
+    return wifi.status;
+}
+
+bool sdk_wifi_station_dhcpc_start()
+{
+    wifi.dhcp = true;
+    wifi.dhcp_starts++;
+    if (wifi.status == STATION_GOT_IP) {
+        // renew the lease, the address is kept until the lease is bound
+        sim_schedule(DHCP_MS, dhcp_bound, (void*)(uintptr_t)wifi.attempt);
+    }
+    return true;
+}
+
+bool sdk_wifi_station_dhcpc_stop()
+{
+    wifi.dhcp = false;
+    return true;
+}
+
+bool sdk_wifi_set_ip_info(uint8_t if_index, struct ip_info *info)
+{
+    wifi.ip = *info;
+    return true;
+}
+
+bool sdk_wifi_get_ip_info(uint8_t if_index, struct ip_info *info)
+{
+    *info = wifi.ip;
+    return true;
+}
+
+bool sdk_wifi_set_channel(uint8_t channel)
+{
+    wifi.channel = channel;
+    return true;
+}
+
+uint8_t sdk_wifi_get_channel()
+{
+    return wifi.channel;
+}
+
+const char* config_get_ssid()
+{
+    return "ssid";
+}
+
+const char* config_get_ssid_pass()
+{
+    return "pass";
+}
+
+/**
+ * Power on the device with flash content from the previous run.
+ */
+static void boot()
+{
+    static const uint8_t bssid[6] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    static uint8_t flash[CONFIG_APP_DATA_SIZE];
+    memcpy(flash, sim_flash + CONFIG_FLASH_BASE_ADDR, sizeof(flash));
+
+    sim_reset();
+    memcpy(sim_flash + CONFIG_FLASH_BASE_ADDR, flash, sizeof(flash));
+
+    memset(&wifi, 0, sizeof(wifi));
+    memcpy(wifi.ap_bssid, bssid, 6);
+    wifi.ap_channel = 6;
+    wifi.lease_ip = IP(192, 168, 0, 100);
+    wifi.channel = 1;
+}
+
+static uint32_t connect()
+{
+    uint32_t start = sim_now();
+
+    wifi_conn_wait();
+    CHECK(wifi.status == STATION_GOT_IP);
+    return sim_now() - start;
+}
+
+int main()
+{
+    uint32_t full_ms, fast_ms, ms;
+
+    memset(sim_flash, 0xFF, SIM_FLASH_SIZE);
+
+    // first boot: nothing cached, full scan and DHCP, the cache is saved
+    boot();
+    wifi_conn_start();
+    full_ms = connect();
+    CHECK(!wifi.config.bssid_set);
+    CHECK(sim_flash_erases == 1);
+    printf("## first boot, full connect      %6u ms\n", full_ms);
+
+    // next boot: fast connect with the cached BSSID, channel and address,
+    // then DHCP renews the lease and the cache stays as it is
+    boot();
+    wifi_conn_start();
+    fast_ms = connect();
+    CHECK(wifi.config.bssid_set);
+    CHECK(wifi.dhcp && wifi.dhcp_starts == 1);
+    CHECK(wifi.ip.ip.addr == IP(192, 168, 0, 100));
+    vTaskDelay(DHCP_MS * 2);
+    wifi_conn_check();
+    CHECK(sim_flash_erases == 0);
+    printf("## fast connect                  %6u ms\n", fast_ms);
+    CHECK(fast_ms < full_ms);
+
+    // the lease has been given to another host meanwhile: DHCP binds a new
+    // address after the fast connect, the cache is updated
+    boot();
+    wifi.lease_ip = IP(192, 168, 0, 101);
+    wifi_conn_start();
+    connect();
+    CHECK(wifi.ip.ip.addr == IP(192, 168, 0, 100));
+    vTaskDelay(DHCP_MS * 2);
+    CHECK(wifi.ip.ip.addr == IP(192, 168, 0, 101));
+    wifi_conn_check();
+    CHECK(sim_flash_erases == 1);
+
+    // the AP is replaced: fast connect times out, full connect follows and
+    // the new BSSID and channel are cached
+    boot();
+    wifi.ap_bssid[5] = 0x77;
+    wifi.ap_channel = 11;
+    wifi_conn_start();
+    ms = connect();
+    CHECK(ms > WIFI_FAST_CONNECT_TIMEOUT_MS);
+    CHECK(!wifi.config.bssid_set);
+    CHECK(sim_flash_erases == 1);
+    printf("## fast timeout, full connect    %6u ms\n", ms);
+
+    boot();
+    wifi.ap_bssid[5] = 0x77;
+    wifi.ap_channel = 11;
+    wifi_conn_start();
+    ms = connect();
+    CHECK(wifi.config.bssid_set);
+    CHECK(ms == fast_ms);
+
+    // connected from the cache but the network is not usable: invalidate
+    // makes a full connect
+    boot();
+    wifi.ap_bssid[5] = 0x77;
+    wifi.ap_channel = 11;
+    wifi_conn_start();
+    connect();
+    wifi_conn_invalidate();
+    CHECK(wifi.status != STATION_GOT_IP);
+    ms = connect();
+    CHECK(!wifi.config.bssid_set);
+    CHECK(ms >= SCAN_MS + DHCP_MS);
+    printf("## invalidate, full connect      %6u ms\n", ms);
+    // invalidate does nothing when not connected from the cache
+    wifi_conn_invalidate();
+    CHECK(wifi.status == STATION_GOT_IP);
+
+    // reboot right after invalidate: the cache is gone, full connect
+    boot();
+    wifi.ap_bssid[5] = 0x77;
+    wifi.ap_channel = 11;
+    wifi_conn_start();
+    connect();
+    CHECK(wifi.config.bssid_set);
+    wifi_conn_invalidate();
+    boot();
+    wifi.ap_bssid[5] = 0x77;
+    wifi.ap_channel = 11;
+    wifi_conn_start();
+    ms = connect();
+    CHECK(!wifi.config.bssid_set);
+    CHECK(ms >= SCAN_MS + DHCP_MS);
+
+    // connection lost: wait returns when the station has reconnected
+    sim_schedule(0, link_lost, NULL);
+    vTaskDelay(1);
+    CHECK(wifi.status != STATION_GOT_IP);
+    ms = connect();
+    CHECK(ms >= SCAN_MS);
+    printf("## reconnect after link loss     %6u ms\n", ms);
+
+    return sim_failures ? 1 : 0;
+}
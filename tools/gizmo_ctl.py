@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""Local UDP control of esp-gizmo-ir devices.
+
+See app/udp_ctrl.h for the protocol description.
+"""
+
+import argparse
+import http.client
+import socket
+import struct
+import sys
+import time
+
+PORT = 4210
+VERSION = 1
+
+DISCOVER, ANNOUNCE, GET_STATUS, COMMAND, STATUS = range(1, 6)
+RESULTS = ['ok', 'bad session', 'replay', 'bad command', 'bad seq']
+MODES = ['auto', 'cool', 'heat', 'fan']
+
+CMD_ON, CMD_OFF, CMD_MODE, CMD_TEMP, CMD_FAN_LEVEL, CMD_MOVE = range(6)
+
+HEADER = struct.Struct('<2sBBII')
+STATUS_FMT = struct.Struct('<BBBBB3xI')
+CMD_FMT = struct.Struct('<BB')
+
+TEMP_MIN, TEMP_MAX = 17, 30     # AC_TEMP_MIN, AC_TEMP_MAX in ac_control.h
+FAN_LEVEL_MAX = 3               # AC_FAN_LEVEL_MAX
+
+
+def pack(ptype, session=0, seq=0, payload=b''):
+    return HEADER.pack(b'GZ', VERSION, ptype, session, seq) + payload
+
+
+def unpack(data):
+    if len(data) < HEADER.size + STATUS_FMT.size:
+        return None
+    magic, version, ptype, session, seq = HEADER.unpack_from(data)
+    if magic != b'GZ' or version != VERSION:
+        return None
+    result, enabled, mode, temp, fan, last_seq = STATUS_FMT.unpack_from(
+        data, HEADER.size)
+    reply = {
+        'type': ptype, 'session': session, 'seq': seq,
+        'result': result, 'enabled': enabled, 'mode': mode,
+        'temperature': temp, 'fan_level': fan, 'last_seq': last_seq,
+    }
+    if ptype == ANNOUNCE:
+        name = data[HEADER.size + STATUS_FMT.size:].split(b'\0')[0]
+        reply['name'] = name.decode(errors='replace')
+    return reply
+
+
+def format_status(reply):
+    mode = MODES[reply['mode']] if reply['mode'] < len(MODES) else '?'
+    return '{} {} {} {}'.format('on' if reply['enabled'] else 'off', mode,
+                                reply['temperature'], reply['fan_level'])
+
+
+def parse_value(words, low, high):
+    """Return the command argument, an int in range low-high."""
+    try:
+        value = int(words[1])
+    except (IndexError, ValueError):
+        value = None
+    if value is None or not low <= value <= high:
+        raise ValueError('{}: value {}-{} expected'.format(words[0], low,
+                                                           high))
+    return value
+
+
+def parse_command(words):
+    """Convert text command (as used over MQTT) to (cmd, value)."""
+    name = words[0]
+    if name == 'on':
+        return CMD_ON, 0
+    if name == 'off':
+        return CMD_OFF, 0
+    if name in MODES:
+        return CMD_MODE, MODES.index(name)
+    if name == 'temp':
+        return CMD_TEMP, parse_value(words, TEMP_MIN, TEMP_MAX)
+    if name == 'fan_level':
+        return CMD_FAN_LEVEL, parse_value(words, 0, FAN_LEVEL_MAX)
+    if name == 'move':
+        return CMD_MOVE, 0
+    raise ValueError('Unknown command: {}'.format(' '.join(words)))
+
+
+class Device:
+    def __init__(self, host, timeout=0.5):
+        self.addr = (host, PORT)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+        self.session = 0
+        self.seq = 0
+
+    def request(self, packet, seq):
+        self.sock.sendto(packet, self.addr)
+        while True:
+            data, _ = self.sock.recvfrom(256)
+            reply = unpack(data)
+            # skip late replies to earlier requests
+            if reply and reply['seq'] == seq:
+                return reply
+
+    def sync(self):
+        reply = self.request(pack(GET_STATUS), 0)
+        self.session = reply['session']
+        self.seq = reply['last_seq']
+        return reply
+
+    def command(self, cmd, value, retries=2):
+        for _ in range(retries + 1):
+            self.seq = (self.seq + 1) & 0xFFFFFFFF
+            payload = CMD_FMT.pack(cmd, value)
+            reply = self.request(pack(COMMAND, self.session, self.seq,
+                                      payload), self.seq)
+            if reply['result'] in (1, 2, 4):    # out of sync, e.g. reboot
+                self.session = reply['session']
+                self.seq = reply['last_seq']
+                continue
+            return reply
+        return reply
+
+
+def discover(timeout):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    sock.settimeout(timeout)
+    sock.sendto(pack(DISCOVER), ('<broadcast>', PORT))
+    devices = []
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        try:
+            data, addr = sock.recvfrom(256)
+        except socket.timeout:
+            break
+        reply = unpack(data)
+        if reply and reply['type'] == ANNOUNCE:
+            devices.append((addr[0], reply))
+    return devices
+
+
+def percentile(values, p):
+    values = sorted(values)
+    index = min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))
+    return values[index]
+
+
+def bench(device, count, op):
+    device.sync()
+    latencies = []
+    lost = 0
+    for i in range(count):
+        start = time.perf_counter()
+        try:
+            if op == 'status':
+                device.request(pack(GET_STATUS, 0, i + 1), i + 1)
+            else:
+                device.command(CMD_TEMP, 24 + i % 2, retries=0)
+        except socket.timeout:
+            lost += 1
+            continue
+        latencies.append((time.perf_counter() - start) * 1000)
+
+    if not latencies:
+        print('No replies')
+        return
+    print('requests: {}, lost: {}'.format(count, lost))
+    print('latency p50: {:.2f} ms, p99: {:.2f} ms, max: {:.2f} ms'.format(
+        percentile(latencies, 50), percentile(latencies, 99),
+        max(latencies)))
+
+
+def http_bench(host, port, count, url, keep_alive):
+    """Measure HTTP requests per second.
+
+    With keep_alive all requests reuse one connection, otherwise a new
+    connection is opened for each request.
+    """
+    conn = None
+    errors = 0
+    start = time.perf_counter()
+    for _ in range(count):
+        try:
+            if conn is None:
+                conn = http.client.HTTPConnection(host, port, timeout=2)
+            conn.request('GET', url,
+                         headers={'Connection':
+                                  'keep-alive' if keep_alive else 'close'})
+            response = conn.getresponse()
+            response.read()
+            if not keep_alive or response.will_close:
+                conn.close()
+                conn = None
+        except (OSError, http.client.HTTPException):
+            errors += 1
+            conn = None
+    elapsed = time.perf_counter() - start
+    print('requests: {}, errors: {}, {:.1f} requests/s'.format(
+        count, errors, (count - errors) / elapsed))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    sub = parser.add_subparsers(dest='action')
+
+    p = sub.add_parser('discover', help='find devices on the local network')
+    p.add_argument('--ip', action='store_true',
+                   help='print IP address of the only matching device, '
+                   'fail if there are none or several')
+    p.add_argument('--name', help='match device name "location/name"')
+    p.add_argument('--timeout', type=float, default=1.0)
+
+    p = sub.add_parser('status', help='get device status')
+    p.add_argument('host')
+
+    p = sub.add_parser('cmd', help='send command, e.g. "temp 24"')
+    p.add_argument('host')
+    p.add_argument('command', nargs='+')
+
+    p = sub.add_parser('bench', help='measure command latency')
+    p.add_argument('host')
+    p.add_argument('-n', '--count', type=int, default=1000)
+    p.add_argument('--op', choices=['temp', 'status'], default='temp',
+                   help='send temperature commands or status requests')
+
+    p = sub.add_parser('http-bench', help='measure REST API requests/s')
+    p.add_argument('host')
+    p.add_argument('--port', type=int, default=80)
+    p.add_argument('-n', '--count', type=int, default=200)
+    p.add_argument('--url', default='/api/state')
+    p.add_argument('--keep-alive', action='store_true',
+                   help='reuse connection if the server allows it')
+
+    args = parser.parse_args()
+
+    try:
+        if args.action == 'discover':
+            devices = discover(args.timeout)
+            if args.name:
+                devices = [d for d in devices if d[1]['name'] == args.name]
+            if args.ip:
+                if len(devices) != 1:
+                    print('{} matching devices found, specify the device '
+                          'name'.format(len(devices)), file=sys.stderr)
+                    sys.exit(1)
+                print(devices[0][0])
+                return
+            for ip, reply in devices:
+                print('{} {} {}'.format(ip, reply['name'],
+                                        format_status(reply)))
+        elif args.action == 'status':
+            print(format_status(Device(args.host).sync()))
+        elif args.action == 'cmd':
+            device = Device(args.host)
+            device.sync()
+            cmd, value = parse_command(args.command)
+            reply = device.command(cmd, value)
+            print('{}: {}'.format(RESULTS[reply['result']],
+                                  format_status(reply)))
+        elif args.action == 'bench':
+            bench(Device(args.host), args.count, args.op)
+        elif args.action == 'http-bench':
+            http_bench(args.host, args.port, args.count, args.url,
+                       args.keep_alive)
+        else:
+            parser.print_help()
+            sys.exit(1)
+    except socket.timeout:
+        print('No reply from device', file=sys.stderr)
+        sys.exit(1)
+    except ValueError as e:
+        print(e, file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""Pack firmware images for the compressed/delta OTA update.
+
+See app/ota_packed.h for the format description.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import zlib
+
+MAGIC = b'GZP1'
+FLAG_DELTA = 0x01
+WINDOW_BITS = 11
+PORT = 8070
+
+HEADER = struct.Struct('<4sBBHIIII')
+
+TAG_MATCH = 0x80
+TAG_BASE_COPY = 0xC0
+MIN_MATCH = 3
+MAX_MATCH = 0x3F + MIN_MATCH
+MAX_LITERAL = 0x80
+MIN_BASE_COPY = 8
+MAX_CHAIN = 32
+
+
+def varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return out
+
+
+def zigzag(value):
+    return (value << 1) ^ (value >> 63)
+
+
+def match_length(a, a_pos, b, b_pos, limit):
+    length = 0
+    while (length < limit and b_pos + length < len(b) and
+           a[a_pos + length] == b[b_pos + length]):
+        length += 1
+    return length
+
+
+class Packer:
+    def __init__(self, image, base=None, window_bits=WINDOW_BITS):
+        self.image = image
+        self.base = base
+        self.window = 1 << window_bits
+        self.window_bits = window_bits
+        self.out = bytearray()
+        self.literals = bytearray()
+        self.base_index = {}
+        if base:
+            for i in range(len(base) - 3):
+                self.base_index.setdefault(base[i:i + 4], []).append(i)
+
+    def flush_literals(self):
+        lit = self.literals
+        for i in range(0, len(lit), MAX_LITERAL):
+            chunk = lit[i:i + MAX_LITERAL]
+            self.out.append(len(chunk) - 1)
+            self.out += chunk
+        self.literals = bytearray()
+
+    def find_window_match(self, pos, chains):
+        best_len, best_dist = 0, 0
+        key = self.image[pos:pos + 4]
+        limit = min(MAX_MATCH, len(self.image) - pos)
+        for candidate in reversed(chains.get(key, [])[-MAX_CHAIN:]):
+            dist = pos - candidate
+            if dist > self.window:
+                break
+            length = match_length(self.image, pos, self.image, candidate,
+                                  limit)
+            if length > best_len:
+                best_len, best_dist = length, dist
+                if length == limit:
+                    break
+        return best_len, best_dist
+
+    def find_base_match(self, pos, last_delta):
+        image, base = self.image, self.base
+        limit = len(image) - pos
+        best_len, best_delta = 0, 0
+        candidates = []
+        if 0 <= pos + last_delta < len(base):
+            candidates.append(pos + last_delta)
+        candidates += self.base_index.get(image[pos:pos + 4], [])[:MAX_CHAIN]
+        for candidate in candidates:
+            length = match_length(image, pos, base, candidate, limit)
+            if length > best_len:
+                best_len, best_delta = length, candidate - pos
+        return best_len, best_delta
+
+    def pack(self):
+        image = self.image
+        chains = {}
+        last_delta = 0
+        pos = 0
+
+        def add_chain(p):
+            chains.setdefault(image[p:p + 4], []).append(p)
+
+        while pos < len(image):
+            base_len, base_delta = 0, 0
+            if self.base:
+                base_len, base_delta = self.find_base_match(pos, last_delta)
+            win_len, win_dist = self.find_window_match(pos, chains)
+
+            if base_len >= MIN_BASE_COPY and base_len >= win_len:
+                self.flush_literals()
+                self.out.append(TAG_BASE_COPY)
+                self.out += varint(zigzag(base_delta))
+                self.out += varint(base_len)
+                last_delta = base_delta
+                step = base_len
+            elif win_len >= MIN_MATCH + 1:
+                self.flush_literals()
+                self.out.append(TAG_MATCH + win_len - MIN_MATCH)
+                self.out += struct.pack('<H', win_dist - 1)
+                step = win_len
+            else:
+                self.literals.append(image[pos])
+                step = 1
+
+            for p in range(pos, pos + step):
+                add_chain(p)
+            pos += step
+
+        self.flush_literals()
+
+        flags = FLAG_DELTA if self.base else 0
+        base_len = len(self.base) if self.base else 0
+        base_crc = zlib.crc32(self.base) if self.base else 0
+        header = HEADER.pack(MAGIC, flags, self.window_bits, 0, len(image),
+                             zlib.crc32(image), base_len, base_crc)
+        return bytes(header + self.out)
+
+
+def read_varint(data, pos):
+    value, shift = 0, 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def unpack(packed, base=None):
+    """Reference decoder, mirrors app/ota_packed.c."""
+    magic, flags, window_bits, _, image_len, image_crc, base_len, base_crc = \
+        HEADER.unpack_from(packed)
+    if magic != MAGIC:
+        raise ValueError('bad magic')
+    if flags & FLAG_DELTA:
+        if base is None or len(base) < base_len:
+            raise ValueError('base image is required')
+        base = base[:base_len]
+        if zlib.crc32(base) != base_crc:
+            raise ValueError('base image mismatch')
+    window = 1 << window_bits
+    out = bytearray()
+    pos = HEADER.size
+    while len(out) < image_len:
+        tag = packed[pos]
+        pos += 1
+        if tag < TAG_MATCH:
+            out += packed[pos:pos + tag + 1]
+            pos += tag + 1
+        elif tag < TAG_BASE_COPY:
+            length = tag - TAG_MATCH + MIN_MATCH
+            dist = struct.unpack_from('<H', packed, pos)[0] + 1
+            pos += 2
+            if dist > window or dist > len(out):
+                raise ValueError('bad match distance')
+            for _ in range(length):
+                out.append(out[-dist])
+        elif tag == TAG_BASE_COPY and flags & FLAG_DELTA:
+            delta, pos = read_varint(packed, pos)
+            length, pos = read_varint(packed, pos)
+            delta = (delta >> 1) ^ -(delta & 1)
+            offset = len(out) + delta
+            if offset < 0 or offset + length > len(base):
+                raise ValueError('bad base copy')
+            out += base[offset:offset + length]
+        else:
+            raise ValueError('bad tag')
+    if len(out) != image_len or zlib.crc32(out) != image_crc:
+        raise ValueError('image crc mismatch')
+    return bytes(out)
+
+
+def read_file(name):
+    with open(name, 'rb') as f:
+        return f.read()
+
+
+def pack_file(args):
+    image = read_file(args.image)
+    if not image:
+        print('Empty image', file=sys.stderr)
+        sys.exit(1)
+    base = read_file(args.base) if args.base else None
+    packed = Packer(image, base, args.window_bits).pack()
+
+    # round trip check, the image must be reconstructed byte by byte
+    if unpack(packed, base) != image:
+        print('Round trip check failed', file=sys.stderr)
+        sys.exit(1)
+
+    with open(args.output, 'wb') as f:
+        f.write(packed)
+
+    print('{}: {} -> {} bytes ({:.1f}% reduction{})'.format(
+        args.output, len(image), len(packed),
+        100.0 * (len(image) - len(packed)) / len(image),
+        ', delta' if base else ''))
+
+
+def unpack_file(args):
+    packed = read_file(args.packed)
+    base = read_file(args.base) if args.base else None
+    try:
+        image = unpack(packed, base)
+    except (ValueError, IndexError, struct.error) as e:
+        print('Unpack failed: {}'.format(e), file=sys.stderr)
+        sys.exit(1)
+    with open(args.output, 'wb') as f:
+        f.write(image)
+
+
+def send_file(args):
+    packed = read_file(args.packed)
+    with socket.create_connection((args.host, args.port), timeout=60) as s:
+        s.sendall(packed)
+        reply = s.makefile().readline().strip()
+    print(reply or 'No reply from device')
+    if reply != 'OK':
+        sys.exit(1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    sub = parser.add_subparsers(dest='action')
+
+    p = sub.add_parser('pack', help='pack firmware image')
+    p.add_argument('image')
+    p.add_argument('-o', '--output', required=True)
+    p.add_argument('--base', help='image running on the device, makes delta')
+    p.add_argument('--window-bits', type=int, default=WINDOW_BITS,
+                   choices=range(1, WINDOW_BITS + 1))
+    p.set_defaults(func=pack_file)
+
+    p = sub.add_parser('unpack', help='unpack packed image')
+    p.add_argument('packed')
+    p.add_argument('-o', '--output', required=True)
+    p.add_argument('--base')
+    p.set_defaults(func=unpack_file)
+
+    p = sub.add_parser('send', help='send packed image to device')
+    p.add_argument('packed')
+    p.add_argument('host')
+    p.add_argument('--port', type=int, default=PORT)
+    p.set_defaults(func=send_file)
+
+    args = parser.parse_args()
+    if not args.action:
+        parser.print_help()
+        sys.exit(1)
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()